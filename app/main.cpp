@@ -1,10 +1,16 @@
 #include <cassert>
+#include <crypto/aes.hpp>
 #include <crypto/ciphermode.hpp>
 #include <crypto/key.hpp>
+#include <crypto/merkle.hpp>
 #include <crypto/tables.hpp>
 #include <cstdio>
 #include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
 #include <io/io.hpp>
+#include <thread>
 
 #include "crypto/crypto.hpp"
 
@@ -20,30 +26,275 @@ std::string print_block(crypto::Block& block) {
 
 namespace gcm_utils = crypto::ciphermode::gcm_utils;
 
+crypto::Engine cipher_engine(io::Engine engine) {
+    switch (engine) {
+        case io::Engine::AesNi:
+            return crypto::Engine::AesNi;
+        case io::Engine::Bitslice:
+            return crypto::Engine::Bitslice;
+        case io::Engine::Table:
+            return crypto::Engine::Table;
+        default:
+            return crypto::Engine::Auto;
+    }
+}
+
+// Copy the ciphertext of a `GCMShard` output file to `out` and return the
+// `ShardState` it ends with.
+crypto::ciphermode::ShardState copy_shard(const std::string& path,
+                                          std::ostream& out) {
+    constexpr std::size_t TRAILER = crypto::ciphermode::ShardState::SIZE;
+
+    const uint64_t size = std::filesystem::file_size(path);
+    if (size < TRAILER) {
+        throw io::IOError{std::format("shard {} is truncated", path),
+                          errors::Error::Other};
+    }
+
+    std::ifstream in{path, std::ios::binary};
+    std::vector<char> buffer(1 << 16);
+    for (uint64_t left = size - TRAILER; left > 0;) {
+        const std::size_t n = std::min<uint64_t>(left, buffer.size());
+        in.read(buffer.data(), n);
+        out.write(buffer.data(), n);
+        left -= n;
+    }
+
+    std::array<uint8_t, TRAILER> trailer{};
+    in.read((char*)trailer.data(), TRAILER);
+    if (!in) {
+        throw io::IOError{std::format("failed to read shard {}", path),
+                          errors::Error::Other};
+    }
+    return crypto::ciphermode::ShardState::load(trailer.data());
+}
+
+// `--prefetch`: keystream computed ahead, input taken as it arrives
+void set_prefetch(crypto::ciphermode::GCM& cipher, uint64_t kib) {
+    if (kib) {
+        cipher.prefetch(kib * 1024 / crypto::BLOCK_SIZE);
+        cipher.set_interactive(true);
+    }
+}
+
+// `--length`, or up to the end
+uint64_t range_length(const io::IO& io) {
+    return io.range().length.value_or(UINT64_MAX);
+}
+
+// XTS: the first half of the key encrypts the data, the second the sector
+// numbers. Only the ciphertext is written, as long as the plaintext.
+void run_xts(io::IO& io, std::size_t threads) {
+    const io::Key key = io.key();
+    const auto half = key.begin() + key.size() / 2;
+    const crypto::AesKey data_key{io::Key(key.begin(), half)};
+    const crypto::AesKey tweak_key{io::Key(half, key.end())};
+
+    const std::size_t sector_size =
+        io.sector_size() ? io.sector_size()
+                         : crypto::ciphermode::XTS::DEFAULT_UNIT_SIZE;
+    crypto::ciphermode::XTS cipher{data_key,      tweak_key,
+                                   io.input_fd(), io.output_fd(),
+                                   sector_size,   threads};
+    if (io.cmd() == io::Command::Encrypt) {
+        cipher.encrypt_fd();
+    } else {
+        cipher.decrypt_fd();
+    }
+}
+
 int run(int arg, char* argv[]) {
     io::IO io{io::parse_cli(arg, argv)};
 
+    // `std::cin` then has a buffer of its own, which takes whatever the
+    // pipe holds in one read
+    if (io.prefetch()) {
+        std::ios::sync_with_stdio(false);
+    }
+
+    if (!crypto::set_engine(cipher_engine(io.engine()))) {
+        throw io::IOError{"AES-NI is not supported on this CPU",
+                          errors::Error::InvalidArgument};
+    }
+
+    const std::size_t threads = io.threads() != 0
+                                    ? io.threads()
+                                    : std::thread::hardware_concurrency();
+
+    io::ModeOfOperation mode{io.mode_of_op()};
+
+    // two keys in one
+    if (mode == io::ModeOfOperation::XTS) {
+        run_xts(io, threads);
+        return 0;
+    }
+
     crypto::AesKey key{io.key()};
     std::istream& input_fd = io.input_fd();
     std::ostream& output_fd = io.output_fd();
 
-    io::ModeOfOperation mode{io.mode_of_op()};
+    // `--iv`, or a fresh random one
+    crypto::Block given_iv{};
+    if (io.iv()) {
+        std::copy(io.iv()->begin(), io.iv()->end(), given_iv.begin());
+    } else {
+        crypto::fill_bytes_n(given_iv, gcm_utils::IV_SIZE);
+    }
 
     if (mode == io::ModeOfOperation::GCM) {
-        if (io.cmd() == io::Command::Encrypt) {
-            // make iv
-            crypto::Block iv{};
-            crypto::fill_bytes_n(iv, gcm_utils::IV_SIZE);
+        if (io.cmd() == io::Command::Encrypt && !io.range().whole()) {
+            // one shard: ciphertext then its `ShardState`, no IV header
+            crypto::ciphermode::GCMShard cipher{
+                key,      io.input_range(), output_fd, given_iv,
+                io.range().offset / crypto::BLOCK_SIZE, threads};
+            set_prefetch(cipher, io.prefetch());
+            cipher.encrypt_fd();
+
+        } else if (io.cmd() == io::Command::Encrypt) {
+            crypto::Block iv{given_iv};
+            io::Writer::write_block(output_fd, iv, gcm_utils::IV_SIZE);
+            crypto::ciphermode::GCM cipher{key, input_fd, output_fd, iv,
+                                           threads};
+            if (io.aad_fd()) {
+                cipher.add_aad(*io.aad_fd());
+            }
+            set_prefetch(cipher, io.prefetch());
+            cipher.encrypt_fd();
+
+        } else if (io.cmd() == io::Command::Merge) {
+            // IV, the shards without their trailers, then the merged tag
+            crypto::Block iv{given_iv};
             io::Writer::write_block(output_fd, iv, gcm_utils::IV_SIZE);
             crypto::ciphermode::GCM cipher{key, input_fd, output_fd, iv};
+            if (io.aad_fd()) {
+                cipher.add_aad(*io.aad_fd());
+            }
+
+            for (const std::string& shard : io.shards()) {
+                cipher.append_shard(copy_shard(shard, output_fd));
+            }
+            const std::vector<char> tag = cipher.tag();
+            output_fd.write(tag.data(), tag.size());
+
+        } else {
+            crypto::Block iv{};
+            input_fd.read((char*)iv.data(), gcm_utils::IV_SIZE);
+
+            crypto::ciphermode::GCM cipher{key, input_fd, output_fd, iv,
+                                           threads};
+            if (io.aad_fd()) {
+                cipher.add_aad(*io.aad_fd());
+            }
+            if (io.cmd() == io::Command::Verify) {
+                cipher.verify_fd();
+            } else if (!io.range().whole()) {
+                cipher.decrypt_range(io.range().offset, range_length(io));
+            } else {
+                set_prefetch(cipher, io.prefetch());
+                cipher.decrypt_fd();
+            }
+        }
+
+    } else if (mode == io::ModeOfOperation::GMAC) {
+        // nonce then tag, the message itself is not copied
+        crypto::Block iv{};
+        crypto::Block tag{};
+
+        if (io.cmd() == io::Command::Encrypt) {
+            iv = given_iv;
+            crypto::ciphermode::GMAC mac{key, input_fd, iv};
+            tag = mac.tag_fd();
+            io::Writer::write_block(output_fd, iv, gcm_utils::IV_SIZE);
+            io::Writer::write_block(output_fd, tag, crypto::BLOCK_SIZE);
+
+        } else {
+            std::istream& tag_fd = *io.tag_fd();
+            tag_fd.read((char*)iv.data(), gcm_utils::IV_SIZE);
+            tag_fd.read((char*)tag.data(), crypto::BLOCK_SIZE);
+            if (!tag_fd) {
+                throw io::IOError{"tag file is truncated",
+                                  errors::Error::Other};
+            }
+
+            crypto::ciphermode::GMAC mac{key, input_fd, iv};
+            mac.verify_fd(tag);
+        }
+
+    } else if (mode == io::ModeOfOperation::Merkle) {
+        crypto::ciphermode::MerkleGCM container{key, threads};
+
+        if (io.cmd() == io::Command::Encrypt) {
+            const uint64_t chunk_size =
+                io.merkle().chunk_size
+                    ? io.merkle().chunk_size
+                    : crypto::ciphermode::MerkleGCM::DEFAULT_CHUNK_SIZE;
+            container.encrypt_fd(input_fd, output_fd, given_iv, chunk_size);
+
+        } else if (io.cmd() == io::Command::Decrypt) {
+            container.decrypt_fd(input_fd, output_fd);
+
+        } else {
+            const std::vector<uint64_t> bad =
+                io.merkle().chunks.empty()
+                    ? container.verify_fd(input_fd)
+                    : container.verify_chunks(input_fd, io.merkle().chunks);
+            if (bad.size()) {
+                std::string chunks{};
+                for (const uint64_t chunk : bad) {
+                    chunks += std::format(" {}", chunk);
+                }
+                throw io::IOError{
+                    std::format("data integrity violated in chunks{}", chunks),
+                    errors::Error::Other};
+            }
+        }
+
+    } else if (mode == io::ModeOfOperation::OCB) {
+        // nonce, ciphertext and tag, as in GCM
+        crypto::Block iv{};
+        if (io.cmd() == io::Command::Encrypt) {
+            iv = given_iv;
+            io::Writer::write_block(output_fd, iv, gcm_utils::IV_SIZE);
+        } else {
+            input_fd.read((char*)iv.data(), gcm_utils::IV_SIZE);
+            if (!input_fd) {
+                throw io::IOError{"ciphertext is truncated",
+                                  errors::Error::Other};
+            }
+        }
+
+        crypto::ciphermode::OCB cipher{key, input_fd, output_fd, iv,
+                                       threads};
+        if (io.aad_fd()) {
+            cipher.add_aad(*io.aad_fd());
+        }
+        if (io.cmd() == io::Command::Encrypt) {
             cipher.encrypt_fd();
+        } else {
+            cipher.decrypt_fd();
+        }
 
+    } else if (mode == io::ModeOfOperation::CTR) {
+        // the initial counter block, then the ciphertext
+        crypto::Block iv{};
+        if (io.cmd() == io::Command::Encrypt) {
+            crypto::fill_bytes_n(iv, crypto::BLOCK_SIZE);
+            io::Writer::write_block(output_fd, iv, crypto::BLOCK_SIZE);
         } else {
-            crypto::Block iv;
-            const std::size_t bytes_read =
-                input_fd.readsome((char*)iv.data(), gcm_utils::IV_SIZE);
+            input_fd.read((char*)iv.data(), crypto::BLOCK_SIZE);
+            if (!input_fd) {
+                throw io::IOError{"ciphertext is truncated",
+                                  errors::Error::Other};
+            }
+        }
 
-            crypto::ciphermode::GCM cipher{key, input_fd, output_fd, iv};
+        crypto::ciphermode::CTR cipher{key, input_fd, output_fd, iv,
+                                       threads};
+        if (io.cmd() == io::Command::Encrypt) {
+            cipher.encrypt_fd();
+        } else if (!io.range().whole()) {
+            cipher.decrypt_range(io.range().offset, range_length(io));
+        } else {
             cipher.decrypt_fd();
         }
 
@@ -57,10 +308,10 @@ int run(int arg, char* argv[]) {
             cipher.encrypt_fd();
         } else {
             crypto::Block iv;
-            const std::size_t bytes_read =
-                input_fd.readsome((char*)iv.data(), crypto::BLOCK_SIZE);
+            input_fd.read((char*)iv.data(), crypto::BLOCK_SIZE);
 
-            crypto::ciphermode::CBC cipher{key, input_fd, output_fd, iv};
+            crypto::ciphermode::CBC cipher{key, input_fd, output_fd, iv,
+                                           threads};
             cipher.decrypt_fd();
         }
 
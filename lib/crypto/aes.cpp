@@ -1,4 +1,10 @@
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <crypto/aes.hpp>
+#include <crypto/aesni.hpp>
+#include <crypto/bitslice.hpp>
+#include <crypto/cpu.hpp>
 #include <crypto/crypto.hpp>
 #include <crypto/key.hpp>
 #include <crypto/tables.hpp>
@@ -149,8 +155,8 @@ Block inv_mix_columns(const Block matrix) {
                      multiply_by_9[matrix[14]] ^ multiply_by_14[matrix[15]])};
 }
 
-Block add_round_key(Block block, AesKey aes_key, size_t round) {
-    std::vector<uint8_t> key = aes_key.get_key();
+Block add_round_key(Block block, const RoundKeys& keys, size_t round) {
+    const uint8_t* key = keys.encryption();
     return Block{
         static_cast<uint8_t>(block[0] ^ key[BLOCK_SIZE * round]),
         static_cast<uint8_t>(block[1] ^ key[BLOCK_SIZE * round + 1]),
@@ -180,12 +186,14 @@ std::string print_block(Block& block) {
     return result.str();
 }
 
-Block encrypt(Block block, AesKey key) {
+Block encrypt_bytewise(Block block, const AesKey& aes_key) {
+    const RoundKeys& key = aes_key.round_keys();
+
     // Initial round_key
     block = add_round_key(block, key, 0);
 
     // Rounds
-    for (size_t round = 1; round < key.get_rounds(); round++) {
+    for (size_t round = 1; round < key.rounds(); round++) {
         io::Writer::dbg(std::cout, std::format("Encrypt input to round {}: {}",
                                                round, print_block(block)));
 
@@ -207,17 +215,297 @@ Block encrypt(Block block, AesKey key) {
     // Final round
     block = sub_bytes(block);
     block = shift_rows(block);
-    block = add_round_key(block, key, key.get_rounds());
+    block = add_round_key(block, key, key.rounds());
 
     return block;
 }
 
-Block decrypt(Block block, AesKey key) {
+namespace {
+
+inline uint32_t load_word(const uint8_t* bytes) noexcept {
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+           (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+inline void store_word(uint32_t word, uint8_t* bytes) noexcept {
+    bytes[0] = word >> 24;
+    bytes[1] = word >> 16;
+    bytes[2] = word >> 8;
+    bytes[3] = word;
+}
+
+// Portable T-table engine, used when the CPU has no AES-NI: the state is
+// held as four column words, and each round does SubBytes, ShiftRows and
+// MixColumns with four lookups per column.
+//
+// `N` independent blocks go through each round together, so the lookups of
+// one block overlap with the latency of the others. `Rounds` is fixed per
+// instantiation, which lets the compiler unroll the whole cipher.
+template <std::size_t Rounds, std::size_t N>
+void encrypt_ttable(const uint8_t* rk, const Block* in, Block* out) noexcept {
+    uint32_t s[N][4];
+    uint32_t t[N][4];
+
+    // Initial round_key
+    for (std::size_t n = 0; n < N; ++n) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            s[n][c] = load_word(&in[n][4 * c]) ^ load_word(rk + 4 * c);
+        }
+    }
+
+    // Rounds
+#pragma GCC unroll 16
+    for (std::size_t round = 1; round < Rounds; round++) {
+        rk += BLOCK_SIZE;
+        for (std::size_t n = 0; n < N; ++n) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                t[n][c] = te0[s[n][c] >> 24] ^
+                          te1[(s[n][(c + 1) % 4] >> 16) & 0xff] ^
+                          te2[(s[n][(c + 2) % 4] >> 8) & 0xff] ^
+                          te3[s[n][(c + 3) % 4] & 0xff] ^ load_word(rk + 4 * c);
+            }
+        }
+        for (std::size_t n = 0; n < N; ++n) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                s[n][c] = t[n][c];
+            }
+        }
+    }
+
+    // Final round, no MixColumns: pick the plain S(x) byte out of the table
+    // rotation that has it in the right row.
+    rk += BLOCK_SIZE;
+    for (std::size_t n = 0; n < N; ++n) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            store_word((te2[s[n][c] >> 24] & 0xff000000) ^
+                           (te3[(s[n][(c + 1) % 4] >> 16) & 0xff] &
+                            0x00ff0000) ^
+                           (te0[(s[n][(c + 2) % 4] >> 8) & 0xff] &
+                            0x0000ff00) ^
+                           (te1[s[n][(c + 3) % 4] & 0xff] & 0x000000ff) ^
+                           load_word(rk + 4 * c),
+                       &out[n][4 * c]);
+        }
+    }
+}
+
+// Equivalent inverse cipher (FIPS-197 5.3.5) on the inverse T-tables, the
+// mirror image of `encrypt_ttable`. With InvMixColumns folded into the round
+// keys, a decryption round costs the same as an encryption round.
+template <std::size_t Rounds, std::size_t N>
+void decrypt_ttable(const uint8_t* rk, const Block* in, Block* out) noexcept {
+    uint32_t s[N][4];
+    uint32_t t[N][4];
+
+    // Initial round_key
+    for (std::size_t n = 0; n < N; ++n) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            s[n][c] = load_word(&in[n][4 * c]) ^ load_word(rk + 4 * c);
+        }
+    }
+
+    // Rounds
+#pragma GCC unroll 16
+    for (std::size_t round = 1; round < Rounds; round++) {
+        rk += BLOCK_SIZE;
+        for (std::size_t n = 0; n < N; ++n) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                t[n][c] = td0[s[n][c] >> 24] ^
+                          td1[(s[n][(c + 3) % 4] >> 16) & 0xff] ^
+                          td2[(s[n][(c + 2) % 4] >> 8) & 0xff] ^
+                          td3[s[n][(c + 1) % 4] & 0xff] ^ load_word(rk + 4 * c);
+            }
+        }
+        for (std::size_t n = 0; n < N; ++n) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                s[n][c] = t[n][c];
+            }
+        }
+    }
+
+    // Final round, no InvMixColumns
+    rk += BLOCK_SIZE;
+    for (std::size_t n = 0; n < N; ++n) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            store_word((uint32_t(inv_s_box[s[n][c] >> 24]) << 24) ^
+                           (uint32_t(inv_s_box[(s[n][(c + 3) % 4] >> 16) &
+                                               0xff])
+                            << 16) ^
+                           (uint32_t(inv_s_box[(s[n][(c + 2) % 4] >> 8) &
+                                               0xff])
+                            << 8) ^
+                           uint32_t(inv_s_box[s[n][(c + 1) % 4] & 0xff]) ^
+                           load_word(rk + 4 * c),
+                       &out[n][4 * c]);
+        }
+    }
+}
+
+std::atomic<Engine> selected_engine{Engine::Auto};
+
+}  // namespace
+
+bool set_engine(Engine engine) noexcept {
+    if (engine == Engine::AesNi && !cpu::has_aesni()) {
+        return false;
+    }
+    selected_engine.store(engine, std::memory_order_relaxed);
+    return true;
+}
+
+Engine engine() noexcept {
+    const Engine engine = selected_engine.load(std::memory_order_relaxed);
+    if (engine != Engine::Auto) {
+        return engine;
+    }
+    return cpu::has_aesni() ? Engine::AesNi : Engine::Bitslice;
+}
+
+Block encrypt(const Block& block, const RoundKeys& keys) noexcept {
+    Block result{block};
+    switch (engine()) {
+        case Engine::AesNi:
+            aesni::encrypt(keys.encryption(), keys.rounds(), result);
+            return result;
+        case Engine::Bitslice:
+            bitslice::encrypt_blocks(keys.bitsliced(), keys.rounds(), &block,
+                                     &result, 1);
+            return result;
+        default:
+            break;
+    }
+
+    with_rounds(keys.rounds(), [&]<std::size_t R>(
+                                   std::integral_constant<std::size_t, R>) {
+        encrypt_ttable<R, 1>(keys.encryption(), &block, &result);
+    });
+    return result;
+}
+
+void encrypt_blocks(const RoundKeys& keys, std::span<const Block> in,
+                    std::span<Block> out) noexcept {
+    assert(out.size() >= in.size());
+
+    const uint8_t* rk = keys.encryption();
+    const std::size_t rounds = keys.rounds();
+
+    switch (engine()) {
+        case Engine::AesNi:
+            aesni::encrypt_blocks(rk, rounds, in.data(), out.data(),
+                                  in.size());
+            return;
+        case Engine::Bitslice:
+            bitslice::encrypt_blocks(keys.bitsliced(), rounds, in.data(),
+                                     out.data(), in.size());
+            return;
+        default:
+            break;
+    }
+
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        std::size_t i = 0;
+        for (; i + 4 <= in.size(); i += 4) {
+            encrypt_ttable<R, 4>(rk, &in[i], &out[i]);
+        }
+        for (; i < in.size(); ++i) {
+            encrypt_ttable<R, 1>(rk, &in[i], &out[i]);
+        }
+    });
+}
+
+void decrypt_blocks(const RoundKeys& keys, std::span<const Block> in,
+                    std::span<Block> out) noexcept {
+    assert(out.size() >= in.size());
+
+    const std::size_t rounds = keys.rounds();
+
+    switch (engine()) {
+        case Engine::AesNi:
+            aesni::decrypt_blocks(keys.decryption(), rounds, in.data(),
+                                  out.data(), in.size());
+            return;
+        case Engine::Bitslice:
+            bitslice::decrypt_blocks(keys.bitsliced(), rounds, in.data(),
+                                     out.data(), in.size());
+            return;
+        default:
+            break;
+    }
+
+    const uint8_t* rk = keys.decryption();
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        std::size_t i = 0;
+        for (; i + 4 <= in.size(); i += 4) {
+            decrypt_ttable<R, 4>(rk, &in[i], &out[i]);
+        }
+        for (; i < in.size(); ++i) {
+            decrypt_ttable<R, 1>(rk, &in[i], &out[i]);
+        }
+    });
+}
+
+void encrypt_blocks(std::span<const RoundKeys* const> keys,
+                    std::span<const Block> in, std::span<Block> out) noexcept {
+    assert(keys.size() >= in.size() && out.size() >= in.size());
+
+    if (engine() != Engine::AesNi) {
+        for (std::size_t i = 0; i < in.size();) {
+            std::size_t n = 1;
+            while (i + n < in.size() && keys[i + n] == keys[i]) {
+                ++n;
+            }
+            encrypt_blocks(*keys[i], in.subspan(i, n), out.subspan(i, n));
+            i += n;
+        }
+        return;
+    }
+
+    // runs of schedules with the same number of rounds
+    std::array<const uint8_t*, 64> schedules{};
+    for (std::size_t i = 0; i < in.size();) {
+        const std::size_t rounds = keys[i]->rounds();
+        std::size_t n = 0;
+        while (i + n < in.size() && n < schedules.size() &&
+               keys[i + n]->rounds() == rounds) {
+            schedules[n] = keys[i + n]->encryption();
+            ++n;
+        }
+        aesni::encrypt_blocks(schedules.data(), rounds, &in[i], &out[i], n);
+        i += n;
+    }
+}
+
+Block decrypt(const Block& block, const RoundKeys& keys) noexcept {
+    Block result{block};
+    switch (engine()) {
+        case Engine::AesNi:
+            aesni::decrypt(keys.decryption(), keys.rounds(), result);
+            return result;
+        case Engine::Bitslice:
+            bitslice::decrypt_blocks(keys.bitsliced(), keys.rounds(), &block,
+                                     &result, 1);
+            return result;
+        default:
+            break;
+    }
+
+    with_rounds(keys.rounds(), [&]<std::size_t R>(
+                                   std::integral_constant<std::size_t, R>) {
+        decrypt_ttable<R, 1>(keys.decryption(), &block, &result);
+    });
+    return result;
+}
+
+Block decrypt_bytewise(Block block, const AesKey& aes_key) {
+    const RoundKeys& key = aes_key.round_keys();
+
     // Initial round_key
-    block = add_round_key(block, key, key.get_rounds());
+    block = add_round_key(block, key, key.rounds());
 
     // Rounds
-    for (size_t round = key.get_rounds() - 1; round > 0; round--) {
+    for (size_t round = key.rounds() - 1; round > 0; round--) {
         io::Writer::dbg(std::cout, std::format("Decrypt input to round {}: {}",
                                                round, print_block(block)));
 
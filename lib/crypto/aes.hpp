@@ -1,14 +1,67 @@
+#pragma once
+
 #include <crypto/crypto.hpp>
 #include <crypto/key.hpp>
+#include <span>
 
 namespace crypto {
+
+// Block cipher engines behind `encrypt`, `decrypt` and the batch API.
+//  - AesNi: hardware AES rounds, only on CPUs that have them
+//  - Bitslice: constant-time software, eight blocks per pass
+//  - Table: T-table software, fastest without AES-NI but its lookups
+//    depend on key and data, so it leaks through cache timing
+// `Auto` takes AES-NI when the CPU has it and Bitslice otherwise.
+enum class Engine : char {
+    Auto,
+    AesNi,
+    Bitslice,
+    Table,
+};
+
+// Selects the engine for the whole process. Returns false, and leaves the
+// selection alone, when `engine` is not supported on this CPU.
+bool set_engine(Engine engine) noexcept;
+
+// the engine in use, never `Auto`
+Engine engine() noexcept;
+
 Block sub_bytes(const Block matrix);
-Block encrypt(Block block, AesKey key);
 Block shift_rows(const Block matrix);
 Block inv_shift_rows(const Block matrix);
 Block mix_columns(const Block matrix);
 Block inv_mix_columns(const Block matrix);
-Block add_round_key(Block block, AesKey aes_key, size_t round);
-Block encrypt(Block block, AesKey key);
-Block decrypt(Block block, AesKey key);
+Block add_round_key(Block block, const RoundKeys& keys, size_t round);
+Block encrypt(const Block& block, const RoundKeys& keys) noexcept;
+Block decrypt(const Block& block, const RoundKeys& keys) noexcept;
+
+inline Block add_round_key(Block block, const AesKey& key, size_t round) {
+    return add_round_key(block, key.round_keys(), round);
+}
+inline Block encrypt(const Block& block, const AesKey& key) noexcept {
+    return encrypt(block, key.round_keys());
+}
+inline Block decrypt(const Block& block, const AesKey& key) noexcept {
+    return decrypt(block, key.round_keys());
+}
+
+// Batch API: `out[i]` is the encryption (decryption) of `in[i]`. Independent
+// blocks are interleaved to hide the cipher latency, so prefer one call over
+// many single-block calls. `out` must hold at least `in.size()` blocks and
+// may be the same buffer as `in`.
+void encrypt_blocks(const RoundKeys& keys, std::span<const Block> in,
+                    std::span<Block> out) noexcept;
+void decrypt_blocks(const RoundKeys& keys, std::span<const Block> in,
+                    std::span<Block> out) noexcept;
+
+// Multi-key batch: `out[i]` is the encryption of `in[i]` under `*keys[i]`,
+// for modes that run independent streams side by side. With AES-NI eight
+// blocks are in flight whatever their keys, the software engines take the
+// runs of blocks under the same key.
+void encrypt_blocks(std::span<const RoundKeys* const> keys,
+                    std::span<const Block> in, std::span<Block> out) noexcept;
+
+// reference implementation, one pass per round step
+Block encrypt_bytewise(Block block, const AesKey& key);
+Block decrypt_bytewise(Block block, const AesKey& key);
 }  // namespace crypto
@@ -0,0 +1,186 @@
+#include <crypto/aesgcm.hpp>
+#include <crypto/key.hpp>
+#include <crypto/pclmul.hpp>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define AESGCM_TARGET __attribute__((target("aes,pclmul,sse4.1")))
+
+namespace crypto::aesgcm {
+
+namespace {
+
+namespace pclmul = ghash::pclmul;
+
+// counter blocks per pass, one per power of H
+constexpr std::size_t LANES = ghash::Clmul::POWERS;
+
+AESGCM_TARGET inline __m128i load_block(const Block& block) noexcept {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block.data()));
+}
+
+AESGCM_TARGET inline void store_block(__m128i state, Block& block) noexcept {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(block.data()), state);
+}
+
+// The counter is kept byte reversed, which puts its last 4 bytes in the low
+// 32-bit lane as a native integer: counter + j is one PADDD, wrapping
+// around like `gcm_utils::inc_counter`, and one PSHUFB turns it back into
+// a block.
+AESGCM_TARGET inline __m128i counter_at(__m128i counter,
+                                        std::size_t j) noexcept {
+    return _mm_add_epi32(counter, _mm_cvtsi32_si128(int(j)));
+}
+
+template <std::size_t Rounds>
+AESGCM_TARGET inline __m128i keystream(const __m128i* rk,
+                                       __m128i counter) noexcept {
+    __m128i state = _mm_xor_si128(
+        _mm_shuffle_epi8(counter, pclmul::reverse_mask()), rk[0]);
+#pragma GCC unroll 16
+    for (std::size_t round = 1; round < Rounds; ++round) {
+        state = _mm_aesenc_si128(state, rk[round]);
+    }
+    return _mm_aesenclast_si128(state, rk[Rounds]);
+}
+
+template <std::size_t Rounds, bool Decrypt>
+AESGCM_TARGET void crypt_n(const uint8_t* round_keys, const pclmul::Powers& h,
+                           ghash::Element& hash_state, Block& counter,
+                           Block* blocks, std::size_t n) noexcept {
+    __m128i rk[Rounds + 1];
+#pragma GCC unroll 16
+    for (std::size_t round = 0; round <= Rounds; ++round) {
+        rk[round] = _mm_load_si128(
+            reinterpret_cast<const __m128i*>(round_keys + BLOCK_SIZE * round));
+    }
+
+    __m128i ctr = _mm_shuffle_epi8(load_block(counter), pclmul::reverse_mask());
+    __m128i y = pclmul::load_element(hash_state);
+
+    // ciphertext folded into GHASH during a pass: its own input when
+    // decrypting, the output of the previous pass when encrypting
+    const Block* pending = nullptr;
+
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        if constexpr (Decrypt) {
+            pending = blocks + i;
+        }
+
+        __m128i x[LANES]{};
+        if (pending) {
+            for (std::size_t j = 0; j < LANES; ++j) {
+                x[j] = pclmul::load_reflected(pending[j]);
+            }
+            x[0] = _mm_xor_si128(x[0], y);
+        }
+
+        __m128i state[LANES];
+        for (std::size_t j = 0; j < LANES; ++j) {
+            state[j] = _mm_xor_si128(
+                _mm_shuffle_epi8(counter_at(ctr, j), pclmul::reverse_mask()),
+                rk[0]);
+        }
+        ctr = counter_at(ctr, LANES);
+
+        // one multiplication between the AESENC of consecutive rounds,
+        // x[j] by H^(LANES - j)
+        pclmul::Product p = pclmul::zero_product();
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            for (std::size_t j = 0; j < LANES; ++j) {
+                state[j] = _mm_aesenc_si128(state[j], rk[round]);
+            }
+            if (pending && round <= LANES) {
+                const std::size_t j = round - 1;
+                pclmul::multiply_add(p, x[j], h.power(LANES - 1 - j),
+                                     h.power_k(LANES - 1 - j));
+            }
+        }
+        if (pending) {
+            y = pclmul::reduce(p);
+        }
+
+        for (std::size_t j = 0; j < LANES; ++j) {
+            const __m128i key = _mm_aesenclast_si128(state[j], rk[Rounds]);
+            store_block(_mm_xor_si128(load_block(blocks[i + j]), key),
+                        blocks[i + j]);
+        }
+
+        if constexpr (!Decrypt) {
+            pending = blocks + i;
+        }
+    }
+
+    // encrypting leaves the output of the last pass to hash
+    if (!Decrypt && pending) {
+        y = pclmul::update(y, h, pending, LANES);
+    }
+
+    // fewer than `LANES` blocks left, one at a time
+    Block* const tail = blocks + i;
+    const std::size_t tail_size = n - i;
+    if constexpr (Decrypt) {
+        y = pclmul::update(y, h, tail, tail_size);
+    }
+    for (; i < n; ++i) {
+        const __m128i key = keystream<Rounds>(rk, ctr);
+        ctr = counter_at(ctr, 1);
+        store_block(_mm_xor_si128(load_block(blocks[i]), key), blocks[i]);
+    }
+    if constexpr (!Decrypt) {
+        y = pclmul::update(y, h, tail, tail_size);
+    }
+
+    hash_state = pclmul::store_element(y);
+    store_block(_mm_shuffle_epi8(ctr, pclmul::reverse_mask()), counter);
+}
+
+template <bool Decrypt>
+void crypt(const uint8_t* round_keys, std::size_t rounds,
+           const ghash::Clmul& hash, ghash::Element& state, Block& counter,
+           Block* blocks, std::size_t n) noexcept {
+    const pclmul::Powers h{hash.powers(), hash.karatsuba()};
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        crypt_n<R, Decrypt>(round_keys, h, state, counter, blocks, n);
+    });
+}
+
+}  // namespace
+
+void encrypt(const uint8_t* round_keys, std::size_t rounds,
+             const ghash::Clmul& hash, ghash::Element& state, Block& counter,
+             Block* blocks, std::size_t n) noexcept {
+    crypt<false>(round_keys, rounds, hash, state, counter, blocks, n);
+}
+
+void decrypt(const uint8_t* round_keys, std::size_t rounds,
+             const ghash::Clmul& hash, ghash::Element& state, Block& counter,
+             Block* blocks, std::size_t n) noexcept {
+    crypt<true>(round_keys, rounds, hash, state, counter, blocks, n);
+}
+
+}  // namespace crypto::aesgcm
+
+#else
+
+// not x86: `cpu::has_aesni()` is always false, so these are never reached
+namespace crypto::aesgcm {
+
+void encrypt(const uint8_t*, std::size_t, const ghash::Clmul&,
+             ghash::Element&, Block&, Block*, std::size_t) noexcept {
+    std::abort();
+}
+
+void decrypt(const uint8_t*, std::size_t, const ghash::Clmul&,
+             ghash::Element&, Block&, Block*, std::size_t) noexcept {
+    std::abort();
+}
+
+}  // namespace crypto::aesgcm
+
+#endif
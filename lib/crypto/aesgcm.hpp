@@ -0,0 +1,31 @@
+#pragma once
+
+#include <crypto/crypto.hpp>
+#include <crypto/ghash.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// GCM bulk loop with AES-NI and PCLMULQDQ stitched together: while the
+// AESENC rounds of eight counter blocks are in flight, the multiplications
+// of eight ciphertext blocks by H^8..H^1 are issued between them, so both
+// units stay busy. Every block is loaded once, XORed with its keystream and
+// folded into GHASH while it is still in a register.
+//
+// Only call these when `cpu::has_aesni()` and `cpu::has_pclmul()` hold.
+namespace crypto::aesgcm {
+
+// XOR the keystream of `n` counter blocks into `blocks`, starting with
+// `counter`, and fold the ciphertext into the GHASH `state`. `counter` is
+// left at the next unused value; like `gcm_utils::inc_counter`, only its
+// last 4 bytes count, as a big-endian integer that wraps around.
+//
+// `round_keys` is the encryption schedule, `RoundKeys::encryption()`.
+// `encrypt` hashes the blocks after the XOR, `decrypt` before it.
+void encrypt(const uint8_t* round_keys, std::size_t rounds,
+             const ghash::Clmul& hash, ghash::Element& state, Block& counter,
+             Block* blocks, std::size_t n) noexcept;
+void decrypt(const uint8_t* round_keys, std::size_t rounds,
+             const ghash::Clmul& hash, ghash::Element& state, Block& counter,
+             Block* blocks, std::size_t n) noexcept;
+
+}  // namespace crypto::aesgcm
@@ -0,0 +1,435 @@
+#include <crypto/aesni.hpp>
+#include <crypto/key.hpp>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define AESNI_TARGET __attribute__((target("aes,sse4.1")))
+
+namespace crypto::aesni {
+
+namespace {
+
+// w[i] ^= w[i - 1] ^ w[i - 2] ^ ... for the four words of `a`
+AESNI_TARGET inline __m128i prefix_xor(__m128i a) noexcept {
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    return _mm_xor_si128(a, _mm_slli_si128(a, 4));
+}
+
+template <int rcon>
+AESNI_TARGET inline __m128i expand_128_step(__m128i key) noexcept {
+    const __m128i assist =
+        _mm_shuffle_epi32(_mm_aeskeygenassist_si128(key, rcon), 0xff);
+    return _mm_xor_si128(prefix_xor(key), assist);
+}
+
+AESNI_TARGET void expand_128(const uint8_t* key, __m128i* rk) noexcept {
+    rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    rk[1] = expand_128_step<0x01>(rk[0]);
+    rk[2] = expand_128_step<0x02>(rk[1]);
+    rk[3] = expand_128_step<0x04>(rk[2]);
+    rk[4] = expand_128_step<0x08>(rk[3]);
+    rk[5] = expand_128_step<0x10>(rk[4]);
+    rk[6] = expand_128_step<0x20>(rk[5]);
+    rk[7] = expand_128_step<0x40>(rk[6]);
+    rk[8] = expand_128_step<0x80>(rk[7]);
+    rk[9] = expand_128_step<0x1b>(rk[8]);
+    rk[10] = expand_128_step<0x36>(rk[9]);
+}
+
+// one step of the 192-bit schedule: `lo` holds words 0..3 of the previous
+// six, the low half of `hi` words 4..5. Produces the next six words.
+template <int rcon>
+AESNI_TARGET inline void expand_192_step(__m128i& lo, __m128i& hi) noexcept {
+    const __m128i assist =
+        _mm_shuffle_epi32(_mm_aeskeygenassist_si128(hi, rcon), 0x55);
+    lo = _mm_xor_si128(prefix_xor(lo), assist);
+    hi = _mm_xor_si128(hi, _mm_slli_si128(hi, 4));
+    hi = _mm_xor_si128(hi, _mm_shuffle_epi32(lo, 0xff));
+}
+
+AESNI_TARGET inline __m128i join_lo(__m128i a, __m128i b) noexcept {
+    return _mm_castpd_si128(
+        _mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 0));
+}
+
+AESNI_TARGET inline __m128i join_hi(__m128i a, __m128i b) noexcept {
+    return _mm_castpd_si128(
+        _mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 1));
+}
+
+AESNI_TARGET void expand_192(const uint8_t* key, __m128i* rk) noexcept {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    __m128i hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(key + 16));
+
+    rk[0] = lo;
+    rk[1] = hi;
+    expand_192_step<0x01>(lo, hi);
+    rk[1] = join_lo(rk[1], lo);
+    rk[2] = join_hi(lo, hi);
+    expand_192_step<0x02>(lo, hi);
+    rk[3] = lo;
+    rk[4] = hi;
+    expand_192_step<0x04>(lo, hi);
+    rk[4] = join_lo(rk[4], lo);
+    rk[5] = join_hi(lo, hi);
+    expand_192_step<0x08>(lo, hi);
+    rk[6] = lo;
+    rk[7] = hi;
+    expand_192_step<0x10>(lo, hi);
+    rk[7] = join_lo(rk[7], lo);
+    rk[8] = join_hi(lo, hi);
+    expand_192_step<0x20>(lo, hi);
+    rk[9] = lo;
+    rk[10] = hi;
+    expand_192_step<0x40>(lo, hi);
+    rk[10] = join_lo(rk[10], lo);
+    rk[11] = join_hi(lo, hi);
+    expand_192_step<0x80>(lo, hi);
+    rk[12] = lo;
+}
+
+// even round keys of the 256-bit schedule: RotWord, SubWord and rcon
+template <int rcon>
+AESNI_TARGET inline __m128i expand_256_even(__m128i even,
+                                            __m128i odd) noexcept {
+    const __m128i assist =
+        _mm_shuffle_epi32(_mm_aeskeygenassist_si128(odd, rcon), 0xff);
+    return _mm_xor_si128(prefix_xor(even), assist);
+}
+
+// odd round keys of the 256-bit schedule: SubWord only
+AESNI_TARGET inline __m128i expand_256_odd(__m128i odd,
+                                           __m128i even) noexcept {
+    const __m128i assist =
+        _mm_shuffle_epi32(_mm_aeskeygenassist_si128(even, 0), 0xaa);
+    return _mm_xor_si128(prefix_xor(odd), assist);
+}
+
+AESNI_TARGET void expand_256(const uint8_t* key, __m128i* rk) noexcept {
+    rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    rk[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 16));
+    rk[2] = expand_256_even<0x01>(rk[0], rk[1]);
+    rk[3] = expand_256_odd(rk[1], rk[2]);
+    rk[4] = expand_256_even<0x02>(rk[2], rk[3]);
+    rk[5] = expand_256_odd(rk[3], rk[4]);
+    rk[6] = expand_256_even<0x04>(rk[4], rk[5]);
+    rk[7] = expand_256_odd(rk[5], rk[6]);
+    rk[8] = expand_256_even<0x08>(rk[6], rk[7]);
+    rk[9] = expand_256_odd(rk[7], rk[8]);
+    rk[10] = expand_256_even<0x10>(rk[8], rk[9]);
+    rk[11] = expand_256_odd(rk[9], rk[10]);
+    rk[12] = expand_256_even<0x20>(rk[10], rk[11]);
+    rk[13] = expand_256_odd(rk[11], rk[12]);
+    rk[14] = expand_256_even<0x40>(rk[12], rk[13]);
+}
+
+// `RoundKeys` schedules are 64-byte aligned
+AESNI_TARGET inline __m128i load_key(const uint8_t* round_keys,
+                                     std::size_t round) noexcept {
+    return _mm_load_si128(
+        reinterpret_cast<const __m128i*>(round_keys + BLOCK_SIZE * round));
+}
+
+AESNI_TARGET inline __m128i load_block(const Block& block) noexcept {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block.data()));
+}
+
+AESNI_TARGET inline void store_block(__m128i state, Block& block) noexcept {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(block.data()), state);
+}
+
+// blocks in flight per batch, enough to cover the AESENC latency
+constexpr std::size_t LANES = 8;
+
+}  // namespace
+
+AESNI_TARGET void expand_key(const uint8_t* key, std::size_t key_len,
+                             uint8_t* round_keys) noexcept {
+    __m128i rk[15];
+    std::size_t rounds = 0;
+
+    switch (key_len) {
+        case 16:
+            expand_128(key, rk);
+            rounds = 10;
+            break;
+        case 24:
+            expand_192(key, rk);
+            rounds = 12;
+            break;
+        case 32:
+            expand_256(key, rk);
+            rounds = 14;
+            break;
+        default:
+            std::abort();
+    }
+
+    for (std::size_t i = 0; i <= rounds; ++i) {
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(round_keys + BLOCK_SIZE * i), rk[i]);
+    }
+}
+
+namespace {
+
+// Kernels below are instantiated per round count, the round loops are
+// unrolled into straight-line AESENC/AESDEC sequences.
+
+template <std::size_t Rounds>
+AESNI_TARGET inline void load_schedule(const uint8_t* round_keys,
+                                       __m128i* rk) noexcept {
+#pragma GCC unroll 16
+    for (std::size_t round = 0; round <= Rounds; ++round) {
+        rk[round] = load_key(round_keys, round);
+    }
+}
+
+template <std::size_t Rounds>
+AESNI_TARGET void encrypt_n(const uint8_t* round_keys, const Block* in,
+                            Block* out, std::size_t n) noexcept {
+    __m128i rk[Rounds + 1];
+    load_schedule<Rounds>(round_keys, rk);
+
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        __m128i state[LANES];
+        for (std::size_t j = 0; j < LANES; ++j) {
+            state[j] = _mm_xor_si128(load_block(in[i + j]), rk[0]);
+        }
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            for (std::size_t j = 0; j < LANES; ++j) {
+                state[j] = _mm_aesenc_si128(state[j], rk[round]);
+            }
+        }
+        for (std::size_t j = 0; j < LANES; ++j) {
+            store_block(_mm_aesenclast_si128(state[j], rk[Rounds]),
+                        out[i + j]);
+        }
+    }
+
+    for (; i < n; ++i) {
+        __m128i state = _mm_xor_si128(load_block(in[i]), rk[0]);
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            state = _mm_aesenc_si128(state, rk[round]);
+        }
+        store_block(_mm_aesenclast_si128(state, rk[Rounds]), out[i]);
+    }
+}
+
+template <std::size_t Rounds>
+AESNI_TARGET void decrypt_n(const uint8_t* round_keys, const Block* in,
+                            Block* out, std::size_t n) noexcept {
+    __m128i rk[Rounds + 1];
+    load_schedule<Rounds>(round_keys, rk);
+
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        __m128i state[LANES];
+        for (std::size_t j = 0; j < LANES; ++j) {
+            state[j] = _mm_xor_si128(load_block(in[i + j]), rk[0]);
+        }
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            for (std::size_t j = 0; j < LANES; ++j) {
+                state[j] = _mm_aesdec_si128(state[j], rk[round]);
+            }
+        }
+        for (std::size_t j = 0; j < LANES; ++j) {
+            store_block(_mm_aesdeclast_si128(state[j], rk[Rounds]),
+                        out[i + j]);
+        }
+    }
+
+    for (; i < n; ++i) {
+        __m128i state = _mm_xor_si128(load_block(in[i]), rk[0]);
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            state = _mm_aesdec_si128(state, rk[round]);
+        }
+        store_block(_mm_aesdeclast_si128(state, rk[Rounds]), out[i]);
+    }
+}
+
+// `encrypt_n` with a schedule per block, round keys are loaded as they
+// are needed instead of kept in registers
+template <std::size_t Rounds>
+AESNI_TARGET void encrypt_n_keys(const uint8_t* const* round_keys,
+                                 const Block* in, Block* out,
+                                 std::size_t n) noexcept {
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        const uint8_t* const* rk = round_keys + i;
+        __m128i state[LANES];
+        for (std::size_t j = 0; j < LANES; ++j) {
+            state[j] = _mm_xor_si128(load_block(in[i + j]), load_key(rk[j], 0));
+        }
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            for (std::size_t j = 0; j < LANES; ++j) {
+                state[j] = _mm_aesenc_si128(state[j], load_key(rk[j], round));
+            }
+        }
+        for (std::size_t j = 0; j < LANES; ++j) {
+            store_block(
+                _mm_aesenclast_si128(state[j], load_key(rk[j], Rounds)),
+                out[i + j]);
+        }
+    }
+
+    for (; i < n; ++i) {
+        __m128i state =
+            _mm_xor_si128(load_block(in[i]), load_key(round_keys[i], 0));
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            state = _mm_aesenc_si128(state, load_key(round_keys[i], round));
+        }
+        store_block(
+            _mm_aesenclast_si128(state, load_key(round_keys[i], Rounds)),
+            out[i]);
+    }
+}
+
+// counter `hi:lo` plus `j` as a block, the high half carries out of the low
+AESNI_TARGET inline __m128i counter_block(uint64_t hi, uint64_t lo,
+                                          std::size_t j) noexcept {
+    const uint64_t low = lo + j;
+    const __m128i reverse =
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(
+        _mm_set_epi64x(int64_t(hi + (low < lo)), int64_t(low)), reverse);
+}
+
+template <std::size_t Rounds>
+AESNI_TARGET void ctr_n(const uint8_t* round_keys, Block& counter,
+                        Block* blocks, std::size_t n) noexcept {
+    __m128i rk[Rounds + 1];
+    load_schedule<Rounds>(round_keys, rk);
+
+    uint64_t halves[2];
+    std::memcpy(halves, counter.data(), sizeof(halves));
+    const uint64_t hi = __builtin_bswap64(halves[0]);
+    const uint64_t lo = __builtin_bswap64(halves[1]);
+
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        __m128i state[LANES];
+        for (std::size_t j = 0; j < LANES; ++j) {
+            state[j] = _mm_xor_si128(counter_block(hi, lo, i + j), rk[0]);
+        }
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            for (std::size_t j = 0; j < LANES; ++j) {
+                state[j] = _mm_aesenc_si128(state[j], rk[round]);
+            }
+        }
+        for (std::size_t j = 0; j < LANES; ++j) {
+            store_block(
+                _mm_xor_si128(_mm_aesenclast_si128(state[j], rk[Rounds]),
+                              load_block(blocks[i + j])),
+                blocks[i + j]);
+        }
+    }
+
+    for (; i < n; ++i) {
+        __m128i state = _mm_xor_si128(counter_block(hi, lo, i), rk[0]);
+#pragma GCC unroll 16
+        for (std::size_t round = 1; round < Rounds; ++round) {
+            state = _mm_aesenc_si128(state, rk[round]);
+        }
+        store_block(_mm_xor_si128(_mm_aesenclast_si128(state, rk[Rounds]),
+                                  load_block(blocks[i])),
+                    blocks[i]);
+    }
+
+    store_block(counter_block(hi, lo, n), counter);
+}
+
+}  // namespace
+
+void encrypt(const uint8_t* round_keys, std::size_t rounds,
+             Block& block) noexcept {
+    encrypt_blocks(round_keys, rounds, &block, &block, 1);
+}
+
+void decrypt(const uint8_t* round_keys, std::size_t rounds,
+             Block& block) noexcept {
+    decrypt_blocks(round_keys, rounds, &block, &block, 1);
+}
+
+void encrypt_blocks(const uint8_t* round_keys, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept {
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        encrypt_n<R>(round_keys, in, out, n);
+    });
+}
+
+void decrypt_blocks(const uint8_t* round_keys, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept {
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        decrypt_n<R>(round_keys, in, out, n);
+    });
+}
+
+void encrypt_blocks(const uint8_t* const* round_keys, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept {
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        encrypt_n_keys<R>(round_keys, in, out, n);
+    });
+}
+
+void ctr_xor(const uint8_t* round_keys, std::size_t rounds, Block& counter,
+             Block* blocks, std::size_t n) noexcept {
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        ctr_n<R>(round_keys, counter, blocks, n);
+    });
+}
+
+}  // namespace crypto::aesni
+
+#else
+
+// not x86: `cpu::has_aesni()` is always false, so these are never reached
+namespace crypto::aesni {
+
+void expand_key(const uint8_t*, std::size_t, uint8_t*) noexcept {
+    std::abort();
+}
+
+void encrypt(const uint8_t*, std::size_t, Block&) noexcept { std::abort(); }
+
+void decrypt(const uint8_t*, std::size_t, Block&) noexcept { std::abort(); }
+
+void encrypt_blocks(const uint8_t*, std::size_t, const Block*, Block*,
+                    std::size_t) noexcept {
+    std::abort();
+}
+
+void decrypt_blocks(const uint8_t*, std::size_t, const Block*, Block*,
+                    std::size_t) noexcept {
+    std::abort();
+}
+
+void encrypt_blocks(const uint8_t* const*, std::size_t, const Block*, Block*,
+                    std::size_t) noexcept {
+    std::abort();
+}
+
+void ctr_xor(const uint8_t*, std::size_t, Block&, Block*,
+             std::size_t) noexcept {
+    std::abort();
+}
+
+}  // namespace crypto::aesni
+
+#endif
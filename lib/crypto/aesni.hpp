@@ -0,0 +1,47 @@
+#pragma once
+
+#include <crypto/crypto.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// AES-NI backend. Only call these when `cpu::has_aesni()` holds, the
+// portable code in aes.cpp is the fallback.
+//
+// Round keys use the FIPS-197 expanded key layout, 16 bytes per round, and
+// must be 16-byte aligned like the `RoundKeys` schedules.
+namespace crypto::aesni {
+
+// expand a 16, 24 or 32 byte `key` into `(rounds + 1) * 16` bytes of
+// `round_keys` with AESKEYGENASSIST
+void expand_key(const uint8_t* key, std::size_t key_len,
+                uint8_t* round_keys) noexcept;
+
+void encrypt(const uint8_t* round_keys, std::size_t rounds,
+             Block& block) noexcept;
+
+// `round_keys` is the equivalent inverse cipher schedule,
+// `RoundKeys::decryption()`
+void decrypt(const uint8_t* round_keys, std::size_t rounds,
+             Block& block) noexcept;
+
+// `n` blocks from `in` to `out`, eight at a time so the AESENC/AESDEC
+// pipeline stays full. `in` and `out` may be the same buffer.
+void encrypt_blocks(const uint8_t* round_keys, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept;
+void decrypt_blocks(const uint8_t* round_keys, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept;
+
+// `n` blocks, block `i` under its own schedule `round_keys[i]`, all of them
+// of `rounds` rounds. Eight blocks are in flight whatever their keys, for
+// independent streams run side by side.
+void encrypt_blocks(const uint8_t* const* round_keys, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept;
+
+// XOR the keystream of `n` counter blocks into `blocks`, starting with
+// `counter`. The counter blocks are made in registers: the whole block is
+// one big-endian 128-bit integer, like `ctr_utils::inc_counter`. `counter`
+// is left at the next unused value.
+void ctr_xor(const uint8_t* round_keys, std::size_t rounds, Block& counter,
+             Block* blocks, std::size_t n) noexcept;
+
+}  // namespace crypto::aesni
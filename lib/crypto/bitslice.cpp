@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <crypto/bitslice.hpp>
+#include <crypto/cpu.hpp>
+#include <crypto/key.hpp>
+#include <cstring>
+
+// The 256-bit kernels are inlined whole into `target("avx2")` functions, no
+// 256-bit vector is passed across a call
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// The layout and the circuits follow BearSSL's aes_ct64. One 64-bit word
+// holds one bit position of all bytes of four blocks; a `W` of 128 or 256
+// bits holds two or four such groups side by side, which the compiler maps
+// to SSE2 (or NEON) and AVX2 registers. Every operation below is a plain
+// XOR, AND, NOT or shift by a constant, so the same code serves all widths.
+namespace crypto::bitslice {
+
+namespace {
+
+using Word128 = uint64_t __attribute__((vector_size(16)));
+using Word256 = uint64_t __attribute__((vector_size(32)));
+
+// blocks held by a state of `W` words
+template <class W>
+inline constexpr std::size_t BLOCKS = 4 * sizeof(W) / sizeof(uint64_t);
+
+inline uint32_t load_le(const uint8_t* bytes) noexcept {
+    return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) |
+           (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+inline void store_le(uint32_t word, uint8_t* bytes) noexcept {
+    bytes[0] = word;
+    bytes[1] = word >> 8;
+    bytes[2] = word >> 16;
+    bytes[3] = word >> 24;
+}
+
+// spread the four words of one block over two 64-bit words, a byte every
+// 16 bits
+inline void interleave_in(uint64_t& q0, uint64_t& q1,
+                          const uint32_t* w) noexcept {
+    uint64_t x0 = w[0], x1 = w[1], x2 = w[2], x3 = w[3];
+    x0 |= x0 << 16;
+    x1 |= x1 << 16;
+    x2 |= x2 << 16;
+    x3 |= x3 << 16;
+    x0 &= 0x0000ffff0000ffff;
+    x1 &= 0x0000ffff0000ffff;
+    x2 &= 0x0000ffff0000ffff;
+    x3 &= 0x0000ffff0000ffff;
+    x0 |= x0 << 8;
+    x1 |= x1 << 8;
+    x2 |= x2 << 8;
+    x3 |= x3 << 8;
+    x0 &= 0x00ff00ff00ff00ff;
+    x1 &= 0x00ff00ff00ff00ff;
+    x2 &= 0x00ff00ff00ff00ff;
+    x3 &= 0x00ff00ff00ff00ff;
+    q0 = x0 | (x2 << 8);
+    q1 = x1 | (x3 << 8);
+}
+
+inline void interleave_out(uint32_t* w, uint64_t q0, uint64_t q1) noexcept {
+    uint64_t x0 = q0 & 0x00ff00ff00ff00ff;
+    uint64_t x1 = q1 & 0x00ff00ff00ff00ff;
+    uint64_t x2 = (q0 >> 8) & 0x00ff00ff00ff00ff;
+    uint64_t x3 = (q1 >> 8) & 0x00ff00ff00ff00ff;
+    x0 |= x0 >> 8;
+    x1 |= x1 >> 8;
+    x2 |= x2 >> 8;
+    x3 |= x3 >> 8;
+    x0 &= 0x0000ffff0000ffff;
+    x1 &= 0x0000ffff0000ffff;
+    x2 &= 0x0000ffff0000ffff;
+    x3 &= 0x0000ffff0000ffff;
+    w[0] = uint32_t(x0) | uint32_t(x0 >> 16);
+    w[1] = uint32_t(x1) | uint32_t(x1 >> 16);
+    w[2] = uint32_t(x2) | uint32_t(x2 >> 16);
+    w[3] = uint32_t(x3) | uint32_t(x3 >> 16);
+}
+
+template <class W>
+inline void swap_bits(W& x, W& y, uint64_t lo, unsigned shift) noexcept {
+    const W a = x;
+    const W b = y;
+    x = (a & lo) | ((b & lo) << shift);
+    y = ((a >> shift) & lo) | (b & ~lo);
+}
+
+// bit matrix transpose between the interleaved bytes and the bitsliced
+// layout, its own inverse
+template <class W>
+inline void ortho(W* q) noexcept {
+    for (std::size_t i = 0; i < 8; i += 2) {
+        swap_bits(q[i], q[i + 1], 0x5555555555555555, 1);
+    }
+    for (std::size_t i : {0, 1, 4, 5}) {
+        swap_bits(q[i], q[i + 2], 0x3333333333333333, 2);
+    }
+    for (std::size_t i = 0; i < 4; ++i) {
+        swap_bits(q[i], q[i + 4], 0x0f0f0f0f0f0f0f0f, 4);
+    }
+}
+
+template <class W>
+void load(const Block* in, W* q) noexcept {
+    constexpr std::size_t groups = sizeof(W) / sizeof(uint64_t);
+    uint64_t lanes[8][groups];
+
+    for (std::size_t g = 0; g < groups; ++g) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            const uint8_t* bytes = in[4 * g + i].data();
+            const uint32_t w[4] = {load_le(bytes), load_le(bytes + 4),
+                                   load_le(bytes + 8), load_le(bytes + 12)};
+            interleave_in(lanes[i][g], lanes[i + 4][g], w);
+        }
+    }
+    std::memcpy(q, lanes, sizeof(lanes));
+    ortho(q);
+}
+
+template <class W>
+void store(W* q, Block* out) noexcept {
+    constexpr std::size_t groups = sizeof(W) / sizeof(uint64_t);
+    uint64_t lanes[8][groups];
+
+    ortho(q);
+    std::memcpy(lanes, q, sizeof(lanes));
+    for (std::size_t g = 0; g < groups; ++g) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            uint32_t w[4];
+            interleave_out(w, lanes[i][g], lanes[i + 4][g]);
+            uint8_t* bytes = out[4 * g + i].data();
+            for (std::size_t c = 0; c < 4; ++c) {
+                store_le(w[c], bytes + 4 * c);
+            }
+        }
+    }
+}
+
+// SubBytes as the Boyar-Peralta circuit: 113 gates, `q[7]` is the most
+// significant bit of every byte
+template <class W>
+inline void sub_bytes(W* q) noexcept {
+    const W x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4];
+    const W x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+    // Top linear transformation
+    const W y14 = x3 ^ x5;
+    const W y13 = x0 ^ x6;
+    const W y9 = x0 ^ x3;
+    const W y8 = x0 ^ x5;
+    const W t0 = x1 ^ x2;
+    const W y1 = t0 ^ x7;
+    const W y4 = y1 ^ x3;
+    const W y12 = y13 ^ y14;
+    const W y2 = y1 ^ x0;
+    const W y5 = y1 ^ x6;
+    const W y3 = y5 ^ y8;
+    const W t1 = x4 ^ y12;
+    const W y15 = t1 ^ x5;
+    const W y20 = t1 ^ x1;
+    const W y6 = y15 ^ x7;
+    const W y10 = y15 ^ t0;
+    const W y11 = y20 ^ y9;
+    const W y7 = x7 ^ y11;
+    const W y17 = y10 ^ y11;
+    const W y19 = y10 ^ y8;
+    const W y16 = t0 ^ y11;
+    const W y21 = y13 ^ y16;
+    const W y18 = x0 ^ y16;
+
+    // Non-linear section
+    const W t2 = y12 & y15;
+    const W t3 = y3 & y6;
+    const W t4 = t3 ^ t2;
+    const W t5 = y4 & x7;
+    const W t6 = t5 ^ t2;
+    const W t7 = y13 & y16;
+    const W t8 = y5 & y1;
+    const W t9 = t8 ^ t7;
+    const W t10 = y2 & y7;
+    const W t11 = t10 ^ t7;
+    const W t12 = y9 & y11;
+    const W t13 = y14 & y17;
+    const W t14 = t13 ^ t12;
+    const W t15 = y8 & y10;
+    const W t16 = t15 ^ t12;
+    const W t17 = t4 ^ t14;
+    const W t18 = t6 ^ t16;
+    const W t19 = t9 ^ t14;
+    const W t20 = t11 ^ t16;
+    const W t21 = t17 ^ y20;
+    const W t22 = t18 ^ y19;
+    const W t23 = t19 ^ y21;
+    const W t24 = t20 ^ y18;
+
+    const W t25 = t21 ^ t22;
+    const W t26 = t21 & t23;
+    const W t27 = t24 ^ t26;
+    const W t28 = t25 & t27;
+    const W t29 = t28 ^ t22;
+    const W t30 = t23 ^ t24;
+    const W t31 = t22 ^ t26;
+    const W t32 = t31 & t30;
+    const W t33 = t32 ^ t24;
+    const W t34 = t23 ^ t33;
+    const W t35 = t27 ^ t33;
+    const W t36 = t24 & t35;
+    const W t37 = t36 ^ t34;
+    const W t38 = t27 ^ t36;
+    const W t39 = t29 & t38;
+    const W t40 = t25 ^ t39;
+
+    const W t41 = t40 ^ t37;
+    const W t42 = t29 ^ t33;
+    const W t43 = t29 ^ t40;
+    const W t44 = t33 ^ t37;
+    const W t45 = t42 ^ t41;
+    const W z0 = t44 & y15;
+    const W z1 = t37 & y6;
+    const W z2 = t33 & x7;
+    const W z3 = t43 & y16;
+    const W z4 = t40 & y1;
+    const W z5 = t29 & y7;
+    const W z6 = t42 & y11;
+    const W z7 = t45 & y17;
+    const W z8 = t41 & y10;
+    const W z9 = t44 & y12;
+    const W z10 = t37 & y3;
+    const W z11 = t33 & y4;
+    const W z12 = t43 & y13;
+    const W z13 = t40 & y5;
+    const W z14 = t29 & y2;
+    const W z15 = t42 & y9;
+    const W z16 = t45 & y14;
+    const W z17 = t41 & y8;
+
+    // Bottom linear transformation
+    const W t46 = z15 ^ z16;
+    const W t47 = z10 ^ z11;
+    const W t48 = z5 ^ z13;
+    const W t49 = z9 ^ z10;
+    const W t50 = z2 ^ z12;
+    const W t51 = z2 ^ z5;
+    const W t52 = z7 ^ z8;
+    const W t53 = z0 ^ z3;
+    const W t54 = z6 ^ z7;
+    const W t55 = z16 ^ z17;
+    const W t56 = z12 ^ t48;
+    const W t57 = t50 ^ t53;
+    const W t58 = z4 ^ t46;
+    const W t59 = z3 ^ t54;
+    const W t60 = t46 ^ t57;
+    const W t61 = z14 ^ t57;
+    const W t62 = t52 ^ t58;
+    const W t63 = t49 ^ t58;
+    const W t64 = z4 ^ t59;
+    const W t65 = t61 ^ t62;
+    const W t66 = z1 ^ t63;
+    const W s0 = t59 ^ t63;
+    const W s6 = t56 ^ ~t62;
+    const W s7 = t48 ^ ~t60;
+    const W t67 = t64 ^ t65;
+    const W s3 = t53 ^ t66;
+    const W s4 = t51 ^ t66;
+    const W s5 = t47 ^ t65;
+    const W s1 = t64 ^ ~s3;
+    const W s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+// x -> A^-1(x ^ 0x63), the inverse of the S-box affine map
+template <class W>
+inline void inv_affine(W* q) noexcept {
+    const W q0 = ~q[0], q1 = ~q[1], q2 = q[2], q3 = q[3];
+    const W q4 = q[4], q5 = ~q[5], q6 = ~q[6], q7 = q[7];
+    q[7] = q1 ^ q4 ^ q6;
+    q[6] = q0 ^ q3 ^ q5;
+    q[5] = q7 ^ q2 ^ q4;
+    q[4] = q6 ^ q1 ^ q3;
+    q[3] = q5 ^ q0 ^ q2;
+    q[2] = q4 ^ q7 ^ q1;
+    q[1] = q3 ^ q6 ^ q0;
+    q[0] = q2 ^ q5 ^ q7;
+}
+
+// InvSubBytes, from S(x) = A(x^-1): x^-1 = A^-1(S(x)), so
+// S^-1(y) = A^-1(S(A^-1(y)))
+template <class W>
+inline void inv_sub_bytes(W* q) noexcept {
+    inv_affine(q);
+    sub_bytes(q);
+    inv_affine(q);
+}
+
+template <class W>
+inline void shift_rows(W* q) noexcept {
+    for (std::size_t i = 0; i < 8; ++i) {
+        const W x = q[i];
+        q[i] = (x & 0x000000000000ffff) | ((x & 0x00000000fff00000) >> 4) |
+               ((x & 0x00000000000f0000) << 12) |
+               ((x & 0x0000ff0000000000) >> 8) |
+               ((x & 0x000000ff00000000) << 8) |
+               ((x & 0xf000000000000000) >> 12) |
+               ((x & 0x0fff000000000000) << 4);
+    }
+}
+
+template <class W>
+inline void inv_shift_rows(W* q) noexcept {
+    for (std::size_t i = 0; i < 8; ++i) {
+        const W x = q[i];
+        q[i] = (x & 0x000000000000ffff) | ((x & 0x000000000fff0000) << 4) |
+               ((x & 0x00000000f0000000) >> 12) |
+               ((x & 0x000000ff00000000) << 8) |
+               ((x & 0x0000ff0000000000) >> 8) |
+               ((x & 0x000f000000000000) << 12) |
+               ((x & 0xfff0000000000000) >> 4);
+    }
+}
+
+// the four rows of a column are 16 bits apart
+template <class W>
+inline W rotr16(W x) noexcept {
+    return (x << 48) | (x >> 16);
+}
+
+template <class W>
+inline W rotr32(W x) noexcept {
+    return (x << 32) | (x >> 32);
+}
+
+template <class W>
+inline void mix_columns(W* q) noexcept {
+    const W q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    const W q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    const W r0 = rotr16(q0), r1 = rotr16(q1), r2 = rotr16(q2);
+    const W r3 = rotr16(q3), r4 = rotr16(q4), r5 = rotr16(q5);
+    const W r6 = rotr16(q6), r7 = rotr16(q7);
+
+    q[0] = q7 ^ r7 ^ r0 ^ rotr32(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rotr32(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ rotr32(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rotr32(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rotr32(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ rotr32(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ rotr32(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ rotr32(q7 ^ r7);
+}
+
+template <class W>
+inline void inv_mix_columns(W* q) noexcept {
+    const W q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    const W q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    const W r0 = rotr16(q0), r1 = rotr16(q1), r2 = rotr16(q2);
+    const W r3 = rotr16(q3), r4 = rotr16(q4), r5 = rotr16(q5);
+    const W r6 = rotr16(q6), r7 = rotr16(q7);
+
+    q[0] = q5 ^ q6 ^ q7 ^ r0 ^ r5 ^ r7 ^ rotr32(q0 ^ q5 ^ q6 ^ r0 ^ r5);
+    q[1] = q0 ^ q5 ^ r0 ^ r1 ^ r5 ^ r6 ^ r7 ^
+           rotr32(q1 ^ q5 ^ q7 ^ r1 ^ r5 ^ r6);
+    q[2] = q0 ^ q1 ^ q6 ^ r1 ^ r2 ^ r6 ^ r7 ^
+           rotr32(q0 ^ q2 ^ q6 ^ r2 ^ r6 ^ r7);
+    q[3] = q0 ^ q1 ^ q2 ^ q5 ^ q6 ^ r0 ^ r2 ^ r3 ^ r5 ^
+           rotr32(q0 ^ q1 ^ q3 ^ q5 ^ q6 ^ q7 ^ r0 ^ r3 ^ r5 ^ r7);
+    q[4] = q1 ^ q2 ^ q3 ^ q5 ^ r1 ^ r3 ^ r4 ^ r5 ^ r6 ^ r7 ^
+           rotr32(q1 ^ q2 ^ q4 ^ q5 ^ q7 ^ r1 ^ r4 ^ r5 ^ r6);
+    q[5] = q2 ^ q3 ^ q4 ^ q6 ^ r2 ^ r4 ^ r5 ^ r6 ^ r7 ^
+           rotr32(q2 ^ q3 ^ q5 ^ q6 ^ r2 ^ r5 ^ r6 ^ r7);
+    q[6] = q3 ^ q4 ^ q5 ^ q7 ^ r3 ^ r5 ^ r6 ^ r7 ^
+           rotr32(q3 ^ q4 ^ q6 ^ q7 ^ r3 ^ r6 ^ r7);
+    q[7] = q4 ^ q5 ^ q6 ^ r4 ^ r6 ^ r7 ^ rotr32(q4 ^ q5 ^ q7 ^ r4 ^ r7);
+}
+
+template <class W>
+inline void add_round_key(W* q, const uint64_t* sk) noexcept {
+    for (std::size_t i = 0; i < 8; ++i) {
+        q[i] ^= sk[i];
+    }
+}
+
+template <std::size_t Rounds, class W>
+void encrypt_n(const uint64_t* sk, const Block* in, Block* out) noexcept {
+    W q[8];
+    load(in, q);
+
+    // Initial round_key
+    add_round_key(q, sk);
+
+    // Rounds
+#pragma GCC unroll 16
+    for (std::size_t round = 1; round < Rounds; ++round) {
+        sub_bytes(q);
+        shift_rows(q);
+        mix_columns(q);
+        add_round_key(q, sk + ROUND_KEY_WORDS * round);
+    }
+
+    // Final round
+    sub_bytes(q);
+    shift_rows(q);
+    add_round_key(q, sk + ROUND_KEY_WORDS * Rounds);
+
+    store(q, out);
+}
+
+template <std::size_t Rounds, class W>
+void decrypt_n(const uint64_t* sk, const Block* in, Block* out) noexcept {
+    W q[8];
+    load(in, q);
+
+    // Initial round_key
+    add_round_key(q, sk + ROUND_KEY_WORDS * Rounds);
+
+    // Rounds
+#pragma GCC unroll 16
+    for (std::size_t round = Rounds - 1; round > 0; --round) {
+        inv_shift_rows(q);
+        inv_sub_bytes(q);
+        add_round_key(q, sk + ROUND_KEY_WORDS * round);
+        inv_mix_columns(q);
+    }
+
+    // Final round
+    inv_shift_rows(q);
+    inv_sub_bytes(q);
+    add_round_key(q, sk);
+
+    store(q, out);
+}
+
+// Runs `kernel` over full passes of `LANES` blocks. The tail goes through a
+// zero padded buffer, with the narrow 64-bit state when it fits.
+template <class Wide, class Narrow>
+void for_each_pass(const Block* in, Block* out, std::size_t n,
+                   Wide&& wide, Narrow&& narrow) noexcept {
+    std::size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        wide(&in[i], &out[i]);
+    }
+    if (i == n) return;
+
+    Block tail[LANES]{};
+    std::copy(&in[i], &in[n], tail);
+    if (n - i <= BLOCKS<uint64_t>) {
+        narrow(tail, tail);
+    } else {
+        wide(tail, tail);
+    }
+    std::copy(tail, tail + (n - i), &out[i]);
+}
+
+static_assert(BLOCKS<Word128> == LANES);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AVX2_TARGET __attribute__((target("avx2"), flatten))
+#else
+#define AVX2_TARGET
+#endif
+
+template <std::size_t Rounds>
+AVX2_TARGET void encrypt_avx2(const uint64_t* sk, const Block* in,
+                              Block* out) noexcept {
+    encrypt_n<Rounds, Word256>(sk, in, out);
+}
+
+template <std::size_t Rounds>
+AVX2_TARGET void decrypt_avx2(const uint64_t* sk, const Block* in,
+                              Block* out) noexcept {
+    decrypt_n<Rounds, Word256>(sk, in, out);
+}
+
+}  // namespace
+
+void slice_key(const uint8_t* round_keys, std::size_t rounds,
+               uint64_t* sliced) noexcept {
+    for (std::size_t round = 0; round <= rounds; ++round) {
+        const uint8_t* key = round_keys + BLOCK_SIZE * round;
+        const uint32_t w[4] = {load_le(key), load_le(key + 4),
+                               load_le(key + 8), load_le(key + 12)};
+
+        // the same key in all four block positions
+        uint64_t q[8];
+        interleave_in(q[0], q[4], w);
+        q[1] = q[2] = q[3] = q[0];
+        q[5] = q[6] = q[7] = q[4];
+        ortho(q);
+        std::copy(q, q + 8, sliced + ROUND_KEY_WORDS * round);
+    }
+}
+
+uint32_t sub_word(uint32_t word) noexcept {
+    const uint32_t w[4] = {word, 0, 0, 0};
+    uint64_t q[8] = {};
+    interleave_in(q[0], q[4], w);
+    ortho(q);
+    sub_bytes(q);
+    ortho(q);
+
+    uint32_t result[4];
+    interleave_out(result, q[0], q[4]);
+    return result[0];
+}
+
+void encrypt_blocks(const uint64_t* sliced, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept {
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        std::size_t i = 0;
+        if (cpu::has_avx2()) {
+            for (; i + BLOCKS<Word256> <= n; i += BLOCKS<Word256>) {
+                encrypt_avx2<R>(sliced, &in[i], &out[i]);
+            }
+        }
+        for_each_pass(
+            &in[i], &out[i], n - i,
+            [&](const Block* src, Block* dst) {
+                encrypt_n<R, Word128>(sliced, src, dst);
+            },
+            [&](const Block* src, Block* dst) {
+                encrypt_n<R, uint64_t>(sliced, src, dst);
+            });
+    });
+}
+
+void decrypt_blocks(const uint64_t* sliced, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept {
+    with_rounds(rounds, [&]<std::size_t R>(
+                            std::integral_constant<std::size_t, R>) {
+        std::size_t i = 0;
+        if (cpu::has_avx2()) {
+            for (; i + BLOCKS<Word256> <= n; i += BLOCKS<Word256>) {
+                decrypt_avx2<R>(sliced, &in[i], &out[i]);
+            }
+        }
+        for_each_pass(
+            &in[i], &out[i], n - i,
+            [&](const Block* src, Block* dst) {
+                decrypt_n<R, Word128>(sliced, src, dst);
+            },
+            [&](const Block* src, Block* dst) {
+                decrypt_n<R, uint64_t>(sliced, src, dst);
+            });
+    });
+}
+
+}  // namespace crypto::bitslice
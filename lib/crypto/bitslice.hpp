@@ -0,0 +1,38 @@
+#pragma once
+
+#include <crypto/crypto.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// Constant-time bitsliced backend, for hosts without AES-NI. The state of
+// eight blocks is spread over eight 128-bit words, one word per bit of each
+// byte, and SubBytes is evaluated as a boolean circuit. CPUs with AVX2 take
+// sixteen blocks in 256-bit words. There is no table lookup and no branch on
+// key or data, so nothing leaks through the cache.
+//
+// Round keys come from `RoundKeys::bitsliced()`: the expanded key in the
+// same bitsliced layout, eight 64-bit words per round.
+namespace crypto::bitslice {
+
+// blocks per pass through the cipher, twice as many with AVX2
+inline constexpr std::size_t LANES = 8;
+
+// 64-bit words per bitsliced round key
+inline constexpr std::size_t ROUND_KEY_WORDS = 8;
+
+// convert `rounds + 1` FIPS-197 round keys, 16 bytes each, into
+// `(rounds + 1) * ROUND_KEY_WORDS` words of `sliced`
+void slice_key(const uint8_t* round_keys, std::size_t rounds,
+               uint64_t* sliced) noexcept;
+
+// SubWord of the key expansion, without the S-box table
+uint32_t sub_word(uint32_t word) noexcept;
+
+// `n` blocks from `in` to `out`, `LANES` or more at a time. A short tail
+// costs as much as a full pass. `in` and `out` may be the same buffer.
+void encrypt_blocks(const uint64_t* sliced, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept;
+void decrypt_blocks(const uint64_t* sliced, std::size_t rounds,
+                    const Block* in, Block* out, std::size_t n) noexcept;
+
+}  // namespace crypto::bitslice
@@ -1,9 +1,17 @@
 #include <algorithm>
-#include <boost/multiprecision/cpp_int.hpp>
+#include <array>
+#include <bit>
+#include <cassert>
 #include <crypto/aes.hpp>
+#include <crypto/aesgcm.hpp>
+#include <crypto/aesni.hpp>
 #include <crypto/ciphermode.hpp>
+#include <crypto/cpu.hpp>
 #include <cstdint>
+#include <cstring>
 #include <io/io.hpp>
+#include <thread>
+#include <vector>
 
 #include "crypto.hpp"
 #include "crypto/key.hpp"
@@ -12,95 +20,306 @@
 namespace crypto::ciphermode {
 
 // CipherMode abstract class
-CipherMode::CipherMode(AES& key, std::istream& in, std::ostream& out, Block& iv)
-    : key_{key}, input_fd_{in}, output_fd_{out}, diffusion_block_{iv} {}
+CipherMode::CipherMode(const AES& key, std::istream& in, std::ostream& out,
+                       const Block& iv)
+    : key_{key.round_keys()},
+      input_fd_{in},
+      output_fd_{out},
+      diffusion_block_{iv} {}
 
 void CipherMode::key_encrypt_inplace(Block& arr) noexcept {
-    Block result = crypto::encrypt(arr, key_);
-    std::copy(result.begin(), result.end(), arr.begin());
+    arr = crypto::encrypt(arr, key_);
 }
 
 void CipherMode::key_decrypt_inplace(Block& block) noexcept {
-    Block result = crypto::decrypt(block, key_);
-    std::copy(result.begin(), result.end(), block.begin());
+    block = crypto::decrypt(block, key_);
 }
 
-void CipherMode::encrypt_fd() noexcept {
-    Block buf{};
+void CipherMode::encrypt_chunk(std::span<Block> blocks) noexcept {
+    for (Block& block : blocks) {
+        encrypt(block);
+    }
+}
+
+void CipherMode::decrypt_chunk(std::span<Block> blocks) noexcept {
+    for (Block& block : blocks) {
+        decrypt(block);
+    }
+}
+
+void CipherMode::encrypt_last(std::span<Block> blocks, std::size_t) {
+    encrypt_chunk(blocks);
+}
+
+void CipherMode::decrypt_last(std::span<Block> blocks, std::size_t) {
+    decrypt_chunk(blocks);
+}
+
+namespace {
+
+// read up to `n` bytes to `dst`, returns the number of bytes read
+std::size_t read_bytes(std::istream& in, uint8_t* dst, std::size_t n) {
+    in.read(reinterpret_cast<char*>(dst), n);
+    return in.gcount();
+}
+
+bool at_end(std::istream& in) {
+    return in.peek() == std::istream::traits_type::eof();
+}
 
-    std::size_t bytes_read =
-        input_fd_.readsome(reinterpret_cast<char*>(buf.data()), BLOCK_SIZE);
+}  // namespace
+
+void CipherMode::set_interactive(bool interactive) noexcept {
+    interactive_ = interactive;
+}
+
+std::size_t CipherMode::read_input(uint8_t* dst, std::size_t n) {
+    if (!interactive_) {
+        return read_bytes(input_fd_, dst, n);
+    }
+
+    // nothing buffered, the next read waits for the writer
+    if (input_fd_.rdbuf()->in_avail() == 0) {
+        idle();
+    }
+    if (at_end(input_fd_)) {
+        return 0;
+    }
+
+    const std::streamsize got =
+        input_fd_.readsome(reinterpret_cast<char*>(dst), n);
+    if (got > 0) {
+        return got;
+    }
+
+    // a stream without a buffer, such as `std::cin` synced with stdio
+    return read_bytes(input_fd_, dst, 1);
+}
+
+void CipherMode::encrypt_fd() {
+    std::vector<Block> chunk(chunk_blocks_ + tail_blocks());
+    uint8_t* const bytes = chunk.front().data();
+
+    // bytes at the front of `chunk` not encrypted yet
+    std::size_t held = 0;
+    bool started = false;
 
     while (true) {
-        if (input_fd_.peek() <= 0) {  // last block
+        const std::size_t bytes_read =
+            read_input(bytes + held, chunk.size() * BLOCK_SIZE - held);
+        held += bytes_read;
+
+        if (interactive_ ? bytes_read == 0 : at_end(input_fd_)) {
             break;
         }
 
-        encrypt(buf);
-        output_fd_ << buf.data();
+        // whole blocks go now, a partial one waits for the rest, as do the
+        // `tail_blocks()` before it
+        const std::size_t blocks =
+            std::max(held / BLOCK_SIZE, tail_blocks()) - tail_blocks();
+        if (blocks == 0) {
+            continue;
+        }
+        encrypt_chunk({chunk.data(), blocks});
+        io::Writer::write_blocks(output_fd_, chunk, blocks);
+        if (interactive_) {
+            output_fd_.flush();
+        }
+        started = true;
 
-        bytes_read =
-            input_fd_.readsome(reinterpret_cast<char*>(buf.data()), BLOCK_SIZE);
+        std::copy(bytes + blocks * BLOCK_SIZE, bytes + held, bytes);
+        held -= blocks * BLOCK_SIZE;
     }
 
-    pad_pkcs7(buf, bytes_read);
-    encrypt(buf);
-    io::Writer::write_block(output_fd_, buf, BLOCK_SIZE);
+    // last chunk, pad the trailing partial block (or an empty message), or
+    // without padding cut it to length
+    std::size_t blocks = held / BLOCK_SIZE;
+    std::size_t remainder = held % BLOCK_SIZE;
+    if (padded() && (remainder != 0 || (blocks == 0 && !started))) {
+        pad_pkcs7(chunk[blocks], remainder);
+        ++blocks;
+        remainder = 0;
+    }
 
-    std::vector<char> t = tag();
-    output_fd_ << t.data();
+    encrypt_last({chunk.data(), blocks + (remainder != 0)}, remainder);
+    io::Writer::write_blocks(output_fd_, chunk, blocks);
+    if (remainder != 0) {
+        io::Writer::write_block(output_fd_, chunk[blocks], remainder);
+    }
+
+    const std::vector<char> t = tag();
+    output_fd_.write(t.data(), t.size());
 };
 
 void CipherMode::decrypt_fd() {
-    Block buf{};
-    Block cache{};
+    // The padded last block and the tag are only known once the input
+    // ends, so the final two blocks of each chunk are held back.
+    constexpr std::size_t HELD_BLOCKS = 2;
+    std::vector<Block> chunk(chunk_blocks_ + HELD_BLOCKS);
+    uint8_t* const bytes = chunk.front().data();
 
-    std::size_t bytes_read =
-        input_fd_.readsome((char*)(cache.data()), BLOCK_SIZE);
+    // bytes at the front of `chunk` not decrypted yet
+    std::size_t held = 0;
 
     while (true) {
-        if (input_fd_.peek() <= 0) {  // last block
+        const std::size_t bytes_read =
+            read_input(bytes + held, chunk.size() * BLOCK_SIZE - held);
+        held += bytes_read;
+
+        if (interactive_ ? bytes_read == 0 : at_end(input_fd_)) {
             break;
         }
 
-        bytes_read = input_fd_.readsome((char*)buf.data(), BLOCK_SIZE);
-        decrypt(cache);
-        io::Writer::write_block(output_fd_, cache, BLOCK_SIZE);
-        cache = buf;
+        const std::size_t blocks =
+            std::max(held / BLOCK_SIZE, HELD_BLOCKS) - HELD_BLOCKS;
+        if (blocks == 0) {
+            continue;
+        }
+        decrypt_chunk({chunk.data(), blocks});
+        io::Writer::write_blocks(output_fd_, chunk, blocks);
+        if (interactive_) {
+            output_fd_.flush();
+        }
+
+        std::copy(bytes + blocks * BLOCK_SIZE, bytes + held, bytes);
+        held -= blocks * BLOCK_SIZE;
+    }
+
+    if (held < tag_size() ||
+        (padded() && (held - tag_size()) % BLOCK_SIZE != 0)) {
+        throw io::IOError{"ciphertext is truncated", errors::Error::Other};
     }
 
-    decrypt(cache);
-    std::size_t bytes_remained = rm_pad_pkcs7(cache);
-    io::Writer::write_block(output_fd_, cache, bytes_remained);
+    const std::size_t payload = held - tag_size();
+    const std::size_t blocks = payload / BLOCK_SIZE;
+    if (!padded()) {
+        const std::size_t remainder = payload % BLOCK_SIZE;
+        decrypt_last({chunk.data(), blocks + (remainder != 0)}, remainder);
+        io::Writer::write_blocks(output_fd_, chunk, blocks);
+        if (remainder != 0) {
+            io::Writer::write_block(output_fd_, chunk[blocks], remainder);
+        }
+    } else if (blocks > 0) {
+        decrypt_chunk({chunk.data(), blocks});
+        io::Writer::write_blocks(output_fd_, chunk, blocks - 1);
+
+        Block& last = chunk[blocks - 1];
+        std::size_t bytes_remained = rm_pad_pkcs7(last);
+        io::Writer::write_block(output_fd_, last, bytes_remained);
+    }
 
     // validate tag
-    std::vector<char> t = tag();
-    if (t.size() == 0) {
+    if (tag_size() == 0) {
         return;
     }
-    Block tt{};
-    std::copy(t.begin(), t.end(), tt.begin());
 
-    using gcm_utils::AuthTag;
+    check_tag(bytes + payload);
+};
+
+void CipherMode::decrypt_range(uint64_t offset, uint64_t length) {
+    if (!seek_block(0)) {
+        throw io::IOError{"only CTR and GCM can decrypt a range",
+                          errors::Error::InvalidArgument};
+    }
+
+    const std::streamoff start = input_fd_.tellg();
+    input_fd_.seekg(0, std::ios::end);
+    const std::streamoff end = input_fd_.tellg();
+    if (start < 0 || end < 0) {
+        throw io::IOError{"a range needs a seekable input",
+                          errors::Error::InvalidArgument};
+    }
+    if (uint64_t(end - start) < tag_size()) {
+        throw io::IOError{"ciphertext is truncated", errors::Error::Other};
+    }
+
+    // the plaintext is as long as the payload, less the padding in the
+    // last block
+    const uint64_t payload = end - start - tag_size();
+    uint64_t plaintext = payload;
+    if (padded()) {
+        if (payload == 0 || payload % BLOCK_SIZE != 0) {
+            throw io::IOError{"ciphertext is truncated", errors::Error::Other};
+        }
+
+        Block last{};
+        input_fd_.seekg(start + std::streamoff(payload - BLOCK_SIZE));
+        read_bytes(input_fd_, last.data(), BLOCK_SIZE);
+        seek_block(payload / BLOCK_SIZE - 1);
+        decrypt_chunk({&last, 1});
+        plaintext = payload - BLOCK_SIZE + rm_pad_pkcs7(last);
+    }
+    if (offset >= plaintext) {
+        return;
+    }
+
+    // bytes left to write, and those before them in the first block
+    uint64_t left = std::min(length, plaintext - offset);
+    std::size_t skip = offset % BLOCK_SIZE;
+
+    const uint64_t first = offset / BLOCK_SIZE;
+    input_fd_.seekg(start + std::streamoff(first * BLOCK_SIZE));
+    seek_block(first);
+
+    std::vector<Block> chunk(chunk_blocks_);
+    while (left > 0) {
+        const std::size_t want = std::min<uint64_t>(
+            chunk_blocks_ * BLOCK_SIZE, skip + left);
+        const std::size_t got = read_bytes(input_fd_, chunk.front().data(),
+                                           (want + BLOCK_SIZE - 1) /
+                                               BLOCK_SIZE * BLOCK_SIZE);
+        if (got < want) {
+            throw io::IOError{"ciphertext is truncated", errors::Error::Other};
+        }
+
+        decrypt_chunk({chunk.data(), (got + BLOCK_SIZE - 1) / BLOCK_SIZE});
+        const std::size_t n = want - skip;
+        if (!output_fd_.write(reinterpret_cast<const char*>(
+                                  chunk.front().data() + skip),
+                              n)) {
+            throw io::IOError{"failed to write to output",
+                              errors::Error::Other};
+        }
+        left -= n;
+        skip = 0;
+    }
+}
+
+void CipherMode::check_tag(const uint8_t* expected) {
+    const std::vector<char> t = tag();
 
     const bool tag_valid =
-        AuthTag::bytes_to_uint128_t(tt) == AuthTag::bytes_to_uint128_t(buf);
+        std::equal(t.begin(), t.end(), reinterpret_cast<const char*>(expected));
     if (!tag_valid) {
         throw io::IOError{"data integrity violated", errors::Error::Other};
     }
-};
+}
 
 // ECB
-ECB::ECB(AES& key, std::istream& in, std::ostream& out, Block& iv)
+ECB::ECB(const AES& key, std::istream& in, std::ostream& out, Block& iv)
     : CipherMode{key, in, out, iv} {};
 
 void ECB::encrypt(Block& buf) noexcept { key_encrypt_inplace(buf); }
 
 void ECB::decrypt(Block& buf) noexcept { key_decrypt_inplace(buf); }
 
+void ECB::encrypt_chunk(std::span<Block> blocks) noexcept {
+    crypto::encrypt_blocks(key_, blocks, blocks);
+}
+
+void ECB::decrypt_chunk(std::span<Block> blocks) noexcept {
+    crypto::decrypt_blocks(key_, blocks, blocks);
+}
+
 // CBC
-CBC::CBC(AES& key, std::istream& in, std::ostream& out, Block& iv)
-    : CipherMode{key, in, out, iv} {};
+CBC::CBC(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+         std::size_t threads)
+    : CipherMode{key, in, out, iv},
+      threads_{std::max<std::size_t>(threads, 1)} {
+    if (threads_ > 1) {
+        chunk_blocks_ = threads_ * RANGE_BLOCKS;
+    }
+}
 
 void CBC::encrypt(Block& buf) noexcept {
     buf ^= diffusion_block_;
@@ -115,65 +334,782 @@ void CBC::decrypt(Block& buf) noexcept {
     diffusion_block_ = ciphertext;
 }
 
+void CBC::decrypt_chunk(std::span<Block> blocks) noexcept {
+    const std::size_t ranges =
+        std::min(threads_, (blocks.size() + RANGE_BLOCKS - 1) / RANGE_BLOCKS);
+    if (ranges <= 1) {
+        diffusion_block_ = chain_decrypt(blocks, diffusion_block_);
+        return;
+    }
+
+    // the ciphertext block before each range, taken before any range is
+    // decrypted in place
+    const std::size_t range_size = (blocks.size() + ranges - 1) / ranges;
+    std::vector<Block> previous(ranges);
+    previous[0] = diffusion_block_;
+    for (std::size_t r = 1; r < ranges; ++r) {
+        previous[r] = blocks[r * range_size - 1];
+    }
+    diffusion_block_ = blocks.back();
+
+    {
+        std::vector<std::jthread> workers{};
+        for (std::size_t r = 0; r < ranges; ++r) {
+            const std::size_t begin = r * range_size;
+            const std::span<Block> range = blocks.subspan(
+                begin, std::min(range_size, blocks.size() - begin));
+
+            const auto run = [this, range, prev = previous[r]] {
+                chain_decrypt(range, prev);
+            };
+            if (r + 1 < ranges) {
+                workers.emplace_back(run);
+            } else {
+                run();
+            }
+        }
+    }
+}
+
+Block CBC::chain_decrypt(std::span<Block> blocks,
+                         Block previous) const noexcept {
+    std::array<Block, BATCH_BLOCKS> plain{};
+
+    for (std::size_t i = 0; i < blocks.size(); i += BATCH_BLOCKS) {
+        const std::span<Block> batch =
+            blocks.subspan(i, std::min(BATCH_BLOCKS, blocks.size() - i));
+        const Block last_ciphertext = batch.back();
+
+        crypto::decrypt_blocks(key_, batch, plain);
+
+        // back to front, so each block still has its predecessor's
+        // ciphertext to XOR with
+        for (std::size_t j = batch.size() - 1; j > 0; --j) {
+            batch[j] = plain[j] ^ batch[j - 1];
+        }
+        batch[0] = plain[0] ^ previous;
+
+        previous = last_ciphertext;
+    }
+    return previous;
+}
+
+// CTR
+CTR::CTR(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+         std::size_t threads)
+    : CipherMode{key, in, out, iv},
+      iv_{iv},
+      threads_{std::max<std::size_t>(threads, 1)} {
+    if (threads_ > 1) {
+        chunk_blocks_ = threads_ * RANGE_BLOCKS;
+    }
+}
+
+void CTR::encrypt(Block& buf) noexcept {
+    Block ctr_register{diffusion_block_};
+    key_encrypt_inplace(ctr_register);
+    buf ^= ctr_register;
+    ctr_utils::inc_counter(diffusion_block_);
+}
+
+void CTR::decrypt(Block& buf) noexcept { encrypt(buf); }
+
+void CTR::seek(uint64_t block) noexcept {
+    diffusion_block_ = iv_;
+    ctr_utils::add_counter(diffusion_block_, block);
+}
+
+bool CTR::seek_block(uint64_t block) noexcept {
+    seek(block);
+    return true;
+}
+
+void CTR::apply_keystream(std::span<Block> blocks,
+                          Block& counter) const noexcept {
+    if (crypto::engine() == Engine::AesNi) {
+        aesni::ctr_xor(key_.encryption(), key_.rounds(), counter,
+                       blocks.data(), blocks.size());
+        return;
+    }
+
+    std::array<Block, BATCH_BLOCKS> ctr_registers{};
+
+    for (std::size_t i = 0; i < blocks.size(); i += BATCH_BLOCKS) {
+        const std::span<Block> batch =
+            blocks.subspan(i, std::min(BATCH_BLOCKS, blocks.size() - i));
+        const std::span<Block> ctr{ctr_registers.data(), batch.size()};
+
+        for (Block& ctr_register : ctr) {
+            ctr_register = counter;
+            ctr_utils::inc_counter(counter);
+        }
+        crypto::encrypt_blocks(key_, ctr, ctr);
+
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            batch[j] ^= ctr[j];
+        }
+    }
+}
+
+void CTR::encrypt_chunk(std::span<Block> blocks) noexcept {
+    const std::size_t ranges =
+        std::min(threads_, (blocks.size() + RANGE_BLOCKS - 1) / RANGE_BLOCKS);
+    if (ranges <= 1) {
+        apply_keystream(blocks, diffusion_block_);
+        return;
+    }
+
+    const Block start{diffusion_block_};
+    const std::size_t range_size = (blocks.size() + ranges - 1) / ranges;
+    {
+        std::vector<std::jthread> workers{};
+        for (std::size_t r = 0; r < ranges; ++r) {
+            const std::size_t begin = r * range_size;
+            const std::span<Block> range = blocks.subspan(
+                begin, std::min(range_size, blocks.size() - begin));
+
+            const auto run = [this, range, start, begin] {
+                Block counter{start};
+                ctr_utils::add_counter(counter, begin);
+                apply_keystream(range, counter);
+            };
+            if (r + 1 < ranges) {
+                workers.emplace_back(run);
+            } else {
+                run();
+            }
+        }
+    }
+    ctr_utils::add_counter(diffusion_block_, blocks.size());
+}
+
+void CTR::decrypt_chunk(std::span<Block> blocks) noexcept {
+    encrypt_chunk(blocks);
+}
+
+namespace ctr_utils {
+
+void inc_counter(Block& block) noexcept {
+    for (std::size_t i = BLOCK_SIZE; i-- > 0;) {
+        ++block[i];
+        if (block[i] != 0) return;
+    }
+}
+
+void add_counter(Block& block, uint64_t n) noexcept {
+    ghash::Element counter = ghash::load(block);
+    counter.lo += n;
+    counter.hi += counter.lo < n;
+    ghash::store(counter, block);
+}
+
+}  // namespace ctr_utils
+
+// XTS
+namespace {
+
+// between host and little-endian byte order, the tweak's
+inline uint64_t little_endian(uint64_t x) noexcept {
+    if constexpr (std::endian::native == std::endian::big) {
+        return __builtin_bswap64(x);
+    }
+    return x;
+}
+
+// `dst ^= src` a word at a time, for the tweaks and offsets that go in
+// twice per block
+inline void xor_words(Block& dst, const Block& src) noexcept {
+    uint64_t d[2];
+    uint64_t s[2];
+    std::memcpy(d, dst.data(), sizeof(d));
+    std::memcpy(s, src.data(), sizeof(s));
+    d[0] ^= s[0];
+    d[1] ^= s[1];
+    std::memcpy(dst.data(), d, sizeof(d));
+}
+
+}  // namespace
+
+namespace xts_utils {
+
+void mul_alpha(Block& tweak) noexcept {
+    uint64_t halves[2];
+    std::memcpy(halves, tweak.data(), sizeof(halves));
+    const uint64_t lo = little_endian(halves[0]);
+    const uint64_t hi = little_endian(halves[1]);
+
+    // shift the 128 bits up, the one that falls off the top comes back as
+    // x^7 + x^2 + x + 1
+    halves[0] = little_endian((lo << 1) ^ (0x87 & -(hi >> 63)));
+    halves[1] = little_endian((hi << 1) | (lo >> 63));
+    std::memcpy(tweak.data(), halves, sizeof(halves));
+}
+
+}  // namespace xts_utils
+
+XTS::XTS(const AES& key, const AES& tweak_key, std::istream& in,
+         std::ostream& out, std::size_t unit_size, std::size_t threads)
+    : CipherMode{key, in, out, Block{}},
+      tweak_key_{tweak_key.round_keys()},
+      unit_blocks_{unit_size / BLOCK_SIZE},
+      threads_{std::max<std::size_t>(threads, 1)} {
+    assert(unit_size % BLOCK_SIZE == 0 && unit_blocks_ > 0 &&
+           unit_size <= MAX_UNIT_SIZE);
+    if (threads_ > 1) {
+        chunk_blocks_ = threads_ * RANGE_BLOCKS;
+    }
+}
+
+void XTS::encrypt(Block& buf) noexcept { crypt_chunk({&buf, 1}, false); }
+
+void XTS::decrypt(Block& buf) noexcept { crypt_chunk({&buf, 1}, true); }
+
+void XTS::seek(uint64_t unit) noexcept {
+    unit_ = unit;
+    index_ = 0;
+}
+
+Block XTS::tweak(uint64_t unit, std::size_t index) const noexcept {
+    // the unit number, little-endian
+    Block t{};
+    for (std::size_t i = 0; i < sizeof(unit); ++i) {
+        t[i] = unit >> (8 * i);
+    }
+    t = crypto::encrypt(t, tweak_key_);
+
+    for (std::size_t i = 0; i < index; ++i) {
+        xts_utils::mul_alpha(t);
+    }
+    return t;
+}
+
+void XTS::crypt_blocks(std::span<Block> blocks, uint64_t unit,
+                       std::size_t index, bool decrypt) const noexcept {
+    std::array<Block, BATCH_BLOCKS> tweaks{};
+    Block t = tweak(unit, index);
+
+    for (std::size_t i = 0; i < blocks.size(); i += BATCH_BLOCKS) {
+        const std::span<Block> batch =
+            blocks.subspan(i, std::min(BATCH_BLOCKS, blocks.size() - i));
+
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            if (index == unit_blocks_) {
+                t = tweak(++unit, 0);
+                index = 0;
+            }
+            tweaks[j] = t;
+            xor_words(batch[j], t);
+            xts_utils::mul_alpha(t);
+            ++index;
+        }
+
+        if (decrypt) {
+            crypto::decrypt_blocks(key_, batch, batch);
+        } else {
+            crypto::encrypt_blocks(key_, batch, batch);
+        }
+
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            xor_words(batch[j], tweaks[j]);
+        }
+    }
+}
+
+void XTS::crypt_chunk(std::span<Block> blocks, bool decrypt) noexcept {
+    const std::size_t ranges =
+        std::min(threads_, (blocks.size() + RANGE_BLOCKS - 1) / RANGE_BLOCKS);
+    const std::size_t range_size =
+        ranges > 1 ? (blocks.size() + ranges - 1) / ranges : blocks.size();
+    {
+        std::vector<std::jthread> workers{};
+        for (std::size_t r = 0; r < ranges; ++r) {
+            const std::size_t begin = r * range_size;
+            const std::span<Block> range = blocks.subspan(
+                begin, std::min(range_size, blocks.size() - begin));
+
+            // every block's tweak follows from its place in the stream
+            const uint64_t block = index_ + begin;
+            const auto run = [this, range, block, decrypt] {
+                crypt_blocks(range, unit_ + block / unit_blocks_,
+                             block % unit_blocks_, decrypt);
+            };
+            if (r + 1 < ranges) {
+                workers.emplace_back(run);
+            } else {
+                run();
+            }
+        }
+    }
+
+    const uint64_t end = index_ + blocks.size();
+    unit_ += end / unit_blocks_;
+    index_ = end % unit_blocks_;
+}
+
+void XTS::encrypt_chunk(std::span<Block> blocks) noexcept {
+    crypt_chunk(blocks, false);
+}
+
+void XTS::decrypt_chunk(std::span<Block> blocks) noexcept {
+    crypt_chunk(blocks, true);
+}
+
+void XTS::steal(Block& full, Block& partial, std::size_t remainder,
+                uint64_t unit, std::size_t index,
+                bool decrypt) const noexcept {
+    // Encryption: the full block is encrypted first, its head is the
+    // ciphertext of the partial block and its tail fills the partial block
+    // up, which is then encrypted in the full block's place. Decryption
+    // undoes it, the last tweak first.
+    const std::size_t first = decrypt ? index + 1 : index;
+    const std::size_t second = decrypt ? index : index + 1;
+
+    Block head{full};
+    crypt_blocks({&head, 1}, unit, first, decrypt);
+
+    Block filled{head};
+    std::copy_n(partial.begin(), remainder, filled.begin());
+    crypt_blocks({&filled, 1}, unit, second, decrypt);
+
+    full = filled;
+    std::copy_n(head.begin(), remainder, partial.begin());
+}
+
+void XTS::crypt_last(std::span<Block> blocks, std::size_t remainder,
+                     bool decrypt) {
+    if (remainder == 0) {
+        crypt_chunk(blocks, decrypt);
+        return;
+    }
+
+    // the place of the partial block, it steals from the one before it in
+    // the same unit
+    const uint64_t block = index_ + blocks.size() - 1;
+    const uint64_t unit = unit_ + block / unit_blocks_;
+    const std::size_t index = block % unit_blocks_;
+    if (index == 0) {
+        throw io::IOError{"the last XTS data unit is shorter than a block",
+                          errors::Error::InvalidArgument};
+    }
+    assert(blocks.size() >= 2);
+
+    const std::size_t n = blocks.size();
+    crypt_chunk(blocks.first(n - 2), decrypt);
+    steal(blocks[n - 2], blocks[n - 1], remainder, unit, index - 1, decrypt);
+    seek(unit + 1);
+}
+
+void XTS::encrypt_last(std::span<Block> blocks, std::size_t remainder) {
+    crypt_last(blocks, remainder, false);
+}
+
+void XTS::decrypt_last(std::span<Block> blocks, std::size_t remainder) {
+    crypt_last(blocks, remainder, true);
+}
+
+void XTS::crypt_unit(uint64_t unit, std::span<uint8_t> data,
+                     bool decrypt) const {
+    if (data.size() < BLOCK_SIZE || data.size() > unit_blocks_ * BLOCK_SIZE) {
+        throw io::IOError{"an XTS data unit is from one block up to the "
+                          "unit size",
+                          errors::Error::InvalidArgument};
+    }
+
+    const std::size_t blocks = data.size() / BLOCK_SIZE;
+    const std::size_t remainder = data.size() % BLOCK_SIZE;
+    Block* const whole = reinterpret_cast<Block*>(data.data());
+    if (remainder == 0) {
+        crypt_blocks({whole, blocks}, unit, 0, decrypt);
+        return;
+    }
+
+    crypt_blocks({whole, blocks - 1}, unit, 0, decrypt);
+
+    Block partial{};
+    uint8_t* const tail = data.data() + blocks * BLOCK_SIZE;
+    std::copy_n(tail, remainder, partial.begin());
+    steal(whole[blocks - 1], partial, remainder, unit, blocks - 1, decrypt);
+    std::copy_n(partial.begin(), remainder, tail);
+}
+
+void XTS::encrypt_unit(uint64_t unit, std::span<uint8_t> data) const {
+    crypt_unit(unit, data, false);
+}
+
+void XTS::decrypt_unit(uint64_t unit, std::span<uint8_t> data) const {
+    crypt_unit(unit, data, true);
+}
+
 // GCM:
 //
 // This implementation:
 //
-// 1. Does not support the additional authenticated data (`aad`),
-//    so it is defaults to an empty vector.
+// 1. The additional authenticated data (`aad`) is optional and given with
+//    `add_aad` before the payload. Like the payload, its length enters the
+//    tag in bytes.
 //
 // 2. The `IV` has 12 random bytes, and the last 4 bytes should
 //    be initialized to zeros, these are the counter bytes.
-GCM::GCM(AES& key, std::istream& in, std::ostream& out, Block& iv)
-    : CipherMode{key, in, out, iv}, tag_{encrypt_cp(Block{}), encrypt_cp(iv)} {
+GCM::GCM(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+         std::size_t threads)
+    : CipherMode{key, in, out, iv},
+      // a whole stream goes through GHASH, worth the 4 KiB tables
+      tag_{encrypt_cp(Block{}), encrypt_cp(iv),
+           gcm_utils::AuthTag::Tables::Bits8},
+      threads_{std::max<std::size_t>(threads, 1)} {
+    if (threads_ > 1) {
+        chunk_blocks_ = threads_ * RANGE_BLOCKS;
+    }
+
     // the actual message starts with counter value 1
     gcm_utils::inc_counter(diffusion_block_);
     tag_.update_tag(Block{});
+    payload_counter_ = diffusion_block_;
 };
 
 void GCM::encrypt_general(Block& m) noexcept {
-    Block ctr_register{diffusion_block_};
-    key_encrypt_inplace(ctr_register);
-    m ^= ctr_register;
+    if (keystream_) {
+        keystream_->apply({&m, 1});
+    } else {
+        Block ctr_register{diffusion_block_};
+        key_encrypt_inplace(ctr_register);
+        m ^= ctr_register;
+    }
     gcm_utils::inc_counter(diffusion_block_);
     payload_len_ += m.size();
 };
 
+void GCM::add_aad(std::span<const uint8_t> aad) noexcept {
+    assert(payload_len_ == 0);
+    aad_len_ += aad.size();
+
+    // top up the partial block left by the previous call
+    if (aad_fill_ > 0) {
+        const std::size_t n = std::min(aad.size(), BLOCK_SIZE - aad_fill_);
+        std::copy_n(aad.begin(), n, aad_block_.begin() + aad_fill_);
+        aad_fill_ += n;
+        aad = aad.subspan(n);
+        if (aad_fill_ < BLOCK_SIZE) {
+            return;
+        }
+        tag_.update_tag(aad_block_);
+        aad_fill_ = 0;
+    }
+
+    std::array<Block, BATCH_BLOCKS> batch{};
+    while (aad.size() >= BLOCK_SIZE) {
+        const std::size_t n = std::min(BATCH_BLOCKS, aad.size() / BLOCK_SIZE);
+        std::copy_n(aad.begin(), n * BLOCK_SIZE, batch[0].begin());
+        tag_.update_tag({batch.data(), n});
+        aad = aad.subspan(n * BLOCK_SIZE);
+    }
+
+    std::copy(aad.begin(), aad.end(), aad_block_.begin());
+    aad_fill_ = aad.size();
+}
+
+void GCM::add_aad(std::istream& aad) {
+    std::vector<uint8_t> buffer(CHUNK_BLOCKS * BLOCK_SIZE);
+    while (aad) {
+        aad.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+        add_aad({buffer.data(), std::size_t(aad.gcount())});
+    }
+    if (aad.bad()) {
+        throw io::IOError{"failed to read additional data",
+                          errors::Error::Other};
+    }
+}
+
+void GCM::pad_aad() noexcept {
+    if (aad_fill_ == 0) {
+        return;
+    }
+    std::fill(aad_block_.begin() + aad_fill_, aad_block_.end(), 0);
+    tag_.update_tag(aad_block_);
+    aad_fill_ = 0;
+}
+
 void GCM::encrypt(Block& buf) noexcept {
+    pad_aad();
     encrypt_general(buf);
     tag_.update_tag(buf);
 }
 
 void GCM::decrypt(Block& buf) noexcept {
+    pad_aad();
     tag_.update_tag(buf);
     encrypt_general(buf);
 }
 
+void GCM::apply_keystream(std::span<Block> blocks,
+                          Block& counter) const noexcept {
+    std::array<Block, BATCH_BLOCKS> ctr_registers{};
+    const std::span<Block> ctr{ctr_registers.data(), blocks.size()};
+
+    for (Block& ctr_register : ctr) {
+        ctr_register = counter;
+        gcm_utils::inc_counter(counter);
+    }
+    crypto::encrypt_blocks(key_, ctr, ctr);
+
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+        blocks[i] ^= ctr[i];
+    }
+}
+
+template <GCM::Pass P>
+void GCM::crypt_range(std::span<Block> blocks, Block& counter,
+                      ghash::Element& state) const noexcept {
+    if constexpr (P == Pass::Verify) {
+        tag_.hash(state, blocks);
+        return;
+    }
+
+    if (crypto::engine() == Engine::AesNi && tag_.clmul()) {
+        const auto stitched =
+            P == Pass::Decrypt ? aesgcm::decrypt : aesgcm::encrypt;
+        stitched(key_.encryption(), key_.rounds(), *tag_.clmul(), state,
+                 counter, blocks.data(), blocks.size());
+        return;
+    }
+
+    for (std::size_t i = 0; i < blocks.size(); i += BATCH_BLOCKS) {
+        const std::span<Block> batch =
+            blocks.subspan(i, std::min(BATCH_BLOCKS, blocks.size() - i));
+
+        if constexpr (P == Pass::Decrypt) {
+            tag_.hash(state, batch);
+        }
+        apply_keystream(batch, counter);
+        if constexpr (P == Pass::Encrypt) {
+            tag_.hash(state, batch);
+        }
+    }
+}
+
+template <GCM::Pass P>
+void GCM::crypt_chunk(std::span<Block> blocks) noexcept {
+    pad_aad();
+    payload_len_ += blocks.size() * BLOCK_SIZE;
+
+    if (keystream_ && P != Pass::Verify) {
+        // for the ready counter blocks only XOR and GHASH are left, a burst
+        // longer than that goes through `crypt_range` as usual
+        const std::span<Block> ready =
+            blocks.first(std::min(blocks.size(), keystream_->size()));
+        if constexpr (P == Pass::Decrypt) {
+            tag_.update_tag(ready);
+        }
+        keystream_->apply(ready);
+        if constexpr (P == Pass::Encrypt) {
+            tag_.update_tag(ready);
+        }
+
+        if (ready.size() < blocks.size()) {
+            Block counter{keystream_->counter()};
+            crypt_range<P>(blocks.subspan(ready.size()), counter,
+                           tag_.state());
+            keystream_->restart(counter);
+        }
+        gcm_utils::add_counter(diffusion_block_, blocks.size());
+        return;
+    }
+
+    const std::size_t ranges =
+        std::min(threads_, (blocks.size() + RANGE_BLOCKS - 1) / RANGE_BLOCKS);
+
+    if (ranges <= 1) {
+        crypt_range<P>(blocks, diffusion_block_, tag_.state());
+        return;
+    }
+
+    const Block start{diffusion_block_};
+    const std::size_t range_size = (blocks.size() + ranges - 1) / ranges;
+    const auto range = [&](std::size_t r) {
+        const std::size_t begin = r * range_size;
+        return blocks.subspan(begin,
+                              std::min(range_size, blocks.size() - begin));
+    };
+
+    // the first range continues the running hash on this thread, the others
+    // start from zero and are combined after the join
+    std::vector<ghash::Element> partial(ranges);
+    {
+        std::vector<std::jthread> workers{};
+        for (std::size_t r = 1; r < ranges; ++r) {
+            workers.emplace_back([&, r] {
+                Block counter{start};
+                gcm_utils::add_counter(counter, r * range_size);
+                crypt_range<P>(range(r), counter, partial[r]);
+            });
+        }
+
+        Block counter{start};
+        crypt_range<P>(range(0), counter, tag_.state());
+    }
+
+    for (std::size_t r = 1; r < ranges; ++r) {
+        tag_.combine(partial[r], range(r).size());
+    }
+    gcm_utils::add_counter(diffusion_block_, blocks.size());
+}
+
+void GCM::encrypt_chunk(std::span<Block> blocks) noexcept {
+    crypt_chunk<Pass::Encrypt>(blocks);
+}
+
+void GCM::decrypt_chunk(std::span<Block> blocks) noexcept {
+    crypt_chunk<Pass::Decrypt>(blocks);
+}
+
+void GCM::verify_fd() {
+    // the tag is only known once the input ends, so the last block of each
+    // chunk is held back
+    std::vector<Block> chunk(chunk_blocks_ + 1);
+    std::size_t held = 0;
+
+    while (true) {
+        held += read_bytes(input_fd_, chunk.front().data() + held,
+                           chunk.size() * BLOCK_SIZE - held);
+
+        if (at_end(input_fd_)) {
+            break;
+        }
+
+        crypt_chunk<Pass::Verify>({chunk.data(), chunk_blocks_});
+        chunk.front() = chunk.back();
+        held = BLOCK_SIZE;
+    }
+
+    if (held < tag_size() || held % BLOCK_SIZE != 0) {
+        throw io::IOError{"ciphertext is truncated", errors::Error::Other};
+    }
+
+    const std::size_t blocks = held / BLOCK_SIZE - 1;
+    crypt_chunk<Pass::Verify>({chunk.data(), blocks});
+    check_tag(chunk[blocks].data());
+}
+
 Block GCM::encrypt_cp(const Block& block) noexcept {
-    Block buf{block};
-    encrypt(buf);
-    return buf;
+    Block ctr_register{diffusion_block_};
+    key_encrypt_inplace(ctr_register);
+    gcm_utils::inc_counter(diffusion_block_);
+    return ctr_register ^ block;
 };
 
 std::vector<char> GCM::tag() noexcept {
     using gcm_utils::AuthTag;
 
-    uint128_t len_a_c{(uint128_t(aad_len_) << 64) | payload_len_};
+    pad_aad();
+    const uint128_t len_a_c{(uint128_t(aad_len_) << 64) | payload_len_};
 
-    len_a_c ^= tag_.value();
+    // the length block is hashed on top of the stream state and taken off
+    // again, so every call returns the same tag
+    const ghash::Element state = tag_.state();
+    Block len_block{};
+    AuthTag::uint128_t_to_bytes(len_a_c, len_block);
+    tag_.update_tag(len_block);
 
-    uint128_t tag = AuthTag::galois_multiply(len_a_c, tag_.H());
-    tag ^= tag_.counter0();
+    const uint128_t tag = tag_.value() ^ tag_.counter0();
+    tag_.state() = state;
 
     Block tag_block{};
     AuthTag::uint128_t_to_bytes(tag, tag_block);
 
-    std::vector<char> tag_out{};
-    for (const auto b : tag_block) {
-        tag_out.push_back(b);
+    return {tag_block.begin(), tag_block.end()};
+}
+
+void GCM::append_shard(const ShardState& shard) {
+    pad_aad();
+
+    if (shard.first_block * BLOCK_SIZE != payload_len_) {
+        throw io::IOError{"shards are not contiguous",
+                          errors::Error::InvalidArgument};
+    }
+
+    tag_.combine(shard.hash, shard.payload_len / BLOCK_SIZE);
+    payload_len_ += shard.payload_len;
+}
+
+void GCM::prefetch(std::size_t blocks) {
+    assert(payload_len_ == 0);
+    keystream_.emplace(key_, diffusion_block_, blocks);
+    keystream_->fill();
+}
+
+void GCM::idle() noexcept {
+    if (keystream_) {
+        keystream_->fill();
     }
+}
+
+bool GCM::seek_block(uint64_t block) noexcept {
+    // the keystream buffer only runs forward
+    keystream_.reset();
+    diffusion_block_ = payload_counter_;
+    gcm_utils::add_counter(diffusion_block_, block);
+    return true;
+}
 
-    return tag_out;
+void GCM::skip_blocks(uint64_t blocks) noexcept {
+    gcm_utils::add_counter(diffusion_block_, blocks);
+}
+
+ShardState GCM::shard_state(uint64_t first_block) const noexcept {
+    return {tag_.state(), first_block, payload_len_};
+}
+
+// ShardState
+void ShardState::store(uint8_t* bytes) const noexcept {
+    Block block{};
+    ghash::store(hash, block);
+    std::copy(block.begin(), block.end(), bytes);
+
+    ghash::store({first_block, payload_len}, block);
+    std::copy(block.begin(), block.end(), bytes + BLOCK_SIZE);
+}
+
+ShardState ShardState::load(const uint8_t* bytes) noexcept {
+    Block block{};
+    std::copy_n(bytes, BLOCK_SIZE, block.begin());
+    const ghash::Element hash = ghash::load(block);
+
+    std::copy_n(bytes + BLOCK_SIZE, BLOCK_SIZE, block.begin());
+    const ghash::Element position = ghash::load(block);
+
+    return {hash, position.hi, position.lo};
+}
+
+// GCMShard
+GCMShard::GCMShard(const AES& key, std::istream& in, std::ostream& out,
+                   Block& iv, uint64_t first_block, std::size_t threads)
+    : GCM{key, in, out, iv, threads}, first_block_{first_block} {
+    skip_blocks(first_block);
+}
+
+std::vector<char> GCMShard::tag() noexcept {
+    std::array<uint8_t, ShardState::SIZE> bytes{};
+    shard_state(first_block_).store(bytes.data());
+    return {bytes.begin(), bytes.end()};
+}
+
+// GMAC
+GMAC::GMAC(const CipherMode::AES& key, std::istream& in, Block& iv)
+    : input_fd_{in}, gcm_{key, in, null_output_, iv} {}
+
+Block GMAC::tag_fd() {
+    gcm_.add_aad(input_fd_);
+
+    const std::vector<char> t = gcm_.tag();
+    Block tag{};
+    std::copy(t.begin(), t.end(), tag.begin());
+    return tag;
+}
+
+void GMAC::verify_fd(const Block& expected) {
+    if (tag_fd() != expected) {
+        throw io::IOError{"data integrity violated", errors::Error::Other};
+    }
 }
 
 namespace gcm_utils {
@@ -185,32 +1121,136 @@ void inc_counter(Block& block) noexcept {
     }
 }
 
-uint128_t AuthTag::bytes_to_uint128_t(const Block& bytes) {
-    uint128_t result = 0;
+void add_counter(Block& block, uint64_t n) noexcept {
+    uint32_t counter = 0;
+    for (std::size_t i = IV_SIZE; i < BLOCK_SIZE; ++i) {
+        counter = (counter << 8) | block[i];
+    }
+    counter += uint32_t(n);
+    for (std::size_t i = BLOCK_SIZE; i-- > IV_SIZE;) {
+        block[i] = uint8_t(counter);
+        counter >>= 8;
+    }
+}
+
+// Keystream
+Keystream::Keystream(const RoundKeys& key, const Block& counter,
+                     std::size_t capacity)
+    : key_{key},
+      ring_(std::max<std::size_t>(capacity, 1)),
+      counter_{counter} {}
 
-    const uint8_t M = bytes.size();
-    for (uint8_t i = 0; i < M; ++i) {
-        result |= uint128_t(bytes[bytes.size() - 1 - i]) << (i * 8);
+void Keystream::fill() noexcept {
+    while (size_ < ring_.size()) {
+        // from the tail up to the end of `ring_` or to the head
+        const std::size_t tail = (head_ + size_) % ring_.size();
+        const std::span<Block> space{
+            ring_.data() + tail,
+            std::min(ring_.size() - size_, ring_.size() - tail)};
+
+        for (Block& ctr_register : space) {
+            ctr_register = counter_;
+            inc_counter(counter_);
+        }
+        crypto::encrypt_blocks(key_, space, space);
+        size_ += space.size();
     }
+}
 
-    return result;
+void Keystream::apply(std::span<Block> blocks) noexcept {
+    while (!blocks.empty()) {
+        if (size_ == 0) {
+            fill();
+        }
+
+        const std::size_t n =
+            std::min({blocks.size(), size_, ring_.size() - head_});
+        for (std::size_t i = 0; i < n; ++i) {
+            blocks[i] ^= ring_[head_ + i];
+        }
+        head_ = (head_ + n) % ring_.size();
+        size_ -= n;
+        blocks = blocks.subspan(n);
+    }
+}
+
+void Keystream::restart(const Block& counter) noexcept {
+    assert(size_ == 0);
+    counter_ = counter;
+}
+
+namespace {
+
+uint64_t reverse_bits(uint64_t x) noexcept {
+    x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+    x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+    x = ((x >> 4) & 0x0f0f0f0f0f0f0f0f) | ((x & 0x0f0f0f0f0f0f0f0f) << 4);
+    return __builtin_bswap64(x);
+}
+
+// the hash key `galois_multiply` effectively multiplies with
+ghash::Element reversed_key(const Block& H) noexcept {
+    const ghash::Element h = ghash::load(H);
+    return {reverse_bits(h.lo), reverse_bits(h.hi)};
+}
+
+}  // namespace
+
+AuthTag::AuthTag(Block H, Block counter_0, Tables tables)
+    : H_{AuthTag::bytes_to_uint128_t(H)},
+      counter_0_{counter_0},
+      table4_{reversed_key(H)},
+      clmul_{cpu::has_pclmul()
+                 ? std::make_unique<const ghash::Clmul>(reversed_key(H))
+                 : nullptr},
+      table8_{!clmul_ && tables == Tables::Bits8
+                  ? std::make_unique<const ghash::Table8>(reversed_key(H))
+                  : nullptr},
+      key_{reversed_key(H)} {}
+
+uint128_t AuthTag::bytes_to_uint128_t(const Block& bytes) noexcept {
+    const ghash::Element e = ghash::load(bytes);
+    return (uint128_t(e.hi) << 64) | e.lo;
 };
 
 const uint128_t& AuthTag::H() const noexcept { return H_; };
 
-void AuthTag::uint128_t_to_bytes(const uint128_t& n, Block& bytes) {
-    const uint8_t M = bytes.size();
-    for (uint8_t i = 0; i < M; ++i) {
-        bytes[i] = uint8_t((n >> ((15 - i) * 8) & 0xff));
-    }
+void AuthTag::uint128_t_to_bytes(const uint128_t& n, Block& bytes) noexcept {
+    ghash::store({uint64_t(n >> 64), uint64_t(n)}, bytes);
 };
 
-void AuthTag::update_tag(const Block& ciphertext) {
-    const uint128_t X = AuthTag::bytes_to_uint128_t(ciphertext) ^ tag_;
-    tag_ = galois_multiply(X, H_);
+void AuthTag::update_tag(const Block& ciphertext) noexcept {
+    if (clmul_) {
+        clmul_->update(tag_, &ciphertext, 1);
+        return;
+    }
+    const ghash::Element X = ghash::load(ciphertext) ^ tag_;
+    tag_ = table8_ ? table8_->multiply(X) : table4_.multiply(X);
+}
+
+void AuthTag::update_tag(std::span<const Block> ciphertext) noexcept {
+    hash(tag_, ciphertext);
+}
+
+void AuthTag::hash(ghash::Element& state,
+                   std::span<const Block> ciphertext) const noexcept {
+    if (clmul_) {
+        clmul_->update(state, ciphertext.data(), ciphertext.size());
+        return;
+    }
+    for (const Block& block : ciphertext) {
+        const ghash::Element X = ghash::load(block) ^ state;
+        state = table8_ ? table8_->multiply(X) : table4_.multiply(X);
+    }
+}
+
+void AuthTag::combine(const ghash::Element& partial,
+                      uint64_t blocks) noexcept {
+    tag_ = ghash::multiply(tag_, ghash::power(key_, blocks)) ^ partial;
 }
 
-uint128_t AuthTag::galois_multiply(const uint128_t& X, const uint128_t& H) {
+uint128_t AuthTag::galois_multiply(const uint128_t& X,
+                                   const uint128_t& H) noexcept {
     // Refer to section 2.5 Multiplication in GF(2^128)
     // https://csrc.nist.rip/groups/ST/toolkit/BCM/documents/proposedmodes/gcm/gcm-spec.pdf
     constexpr static uint128_t R = uint128_t(0b11100001) << 120;
@@ -236,7 +1276,9 @@ uint128_t AuthTag::galois_multiply(const uint128_t& X, const uint128_t& H) {
     return Z;
 }
 
-uint128_t AuthTag::value() const noexcept { return tag_; }
+uint128_t AuthTag::value() const noexcept {
+    return (uint128_t(tag_.hi) << 64) | tag_.lo;
+}
 
 uint128_t AuthTag::counter0() const noexcept {
     return AuthTag::bytes_to_uint128_t(counter_0_);
@@ -244,4 +1286,280 @@ uint128_t AuthTag::counter0() const noexcept {
 
 }  // namespace gcm_utils
 
+// OCB
+namespace ocb_utils {
+
+Block twice(const Block& block) noexcept {
+    Block result{};
+    for (std::size_t i = 0; i + 1 < BLOCK_SIZE; ++i) {
+        result[i] = (block[i] << 1) | (block[i + 1] >> 7);
+    }
+    result[BLOCK_SIZE - 1] = (block[BLOCK_SIZE - 1] << 1) ^
+                             (0x87 & -(block[0] >> 7));
+    return result;
+}
+
+LTable::LTable(const RoundKeys& key) noexcept
+    : star_{crypto::encrypt(Block{}, key)}, dollar_{twice(star_)} {
+    l_[0] = twice(dollar_);
+    for (std::size_t i = 1; i < SIZE; ++i) {
+        l_[i] = twice(l_[i - 1]);
+    }
+}
+
+Block LTable::offset(uint64_t blocks) const noexcept {
+    Block offset{};
+    for (uint64_t gray = blocks ^ (blocks >> 1); gray != 0;
+         gray &= gray - 1) {
+        xor_words(offset, l_[std::countr_zero(gray)]);
+    }
+    return offset;
+}
+
+}  // namespace ocb_utils
+
+OCB::OCB(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+         std::size_t threads)
+    : CipherMode{key, in, out, iv},
+      table_{key_},
+      nonce_offset_{nonce_offset(iv)},
+      threads_{std::max<std::size_t>(threads, 1)} {
+    if (threads_ > 1) {
+        chunk_blocks_ = threads_ * RANGE_BLOCKS;
+    }
+}
+
+Block OCB::nonce_offset(const Block& iv) const noexcept {
+    // Nonce = num2str(TAGLEN mod 128, 7) || zeros(120 - 96) || 1 || N,
+    // with TAGLEN mod 128 = 0
+    Block nonce{};
+    nonce[BLOCK_SIZE - gcm_utils::IV_SIZE - 1] = 1;
+    std::copy_n(iv.begin(), gcm_utils::IV_SIZE,
+                nonce.begin() + BLOCK_SIZE - gcm_utils::IV_SIZE);
+
+    const std::size_t bottom = nonce[BLOCK_SIZE - 1] & 0x3f;
+    nonce[BLOCK_SIZE - 1] &= 0xc0;
+    const Block top = crypto::encrypt(nonce, key_);
+
+    // Stretch = Ktop || (Ktop[1..64] xor Ktop[9..72]), and Offset_0 its
+    // bits from `bottom` on
+    std::array<uint8_t, BLOCK_SIZE + 8 + 1> stretch{};
+    std::copy(top.begin(), top.end(), stretch.begin());
+    for (std::size_t i = 0; i < 8; ++i) {
+        stretch[BLOCK_SIZE + i] = top[i] ^ top[i + 1];
+    }
+
+    const std::size_t bytes = bottom / 8;
+    const std::size_t bits = bottom % 8;
+    Block offset{};
+    for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+        offset[i] = (stretch[i + bytes] << bits) |
+                    (bits ? stretch[i + bytes + 1] >> (8 - bits) : 0);
+    }
+    return offset;
+}
+
+void OCB::encrypt(Block& buf) noexcept { crypt_chunk({&buf, 1}, false); }
+
+void OCB::decrypt(Block& buf) noexcept { crypt_chunk({&buf, 1}, true); }
+
+void OCB::crypt_blocks(std::span<Block> blocks, uint64_t first,
+                       Block& checksum, bool decrypt) const noexcept {
+    std::array<Block, BATCH_BLOCKS> offsets{};
+    Block offset = nonce_offset_ ^ table_.offset(first);
+    uint64_t block = first;
+
+    for (std::size_t i = 0; i < blocks.size(); i += BATCH_BLOCKS) {
+        const std::span<Block> batch =
+            blocks.subspan(i, std::min(BATCH_BLOCKS, blocks.size() - i));
+
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            xor_words(offset, table_[std::countr_zero(++block)]);
+            offsets[j] = offset;
+            if (!decrypt) {
+                xor_words(checksum, batch[j]);
+            }
+            xor_words(batch[j], offset);
+        }
+
+        if (decrypt) {
+            crypto::decrypt_blocks(key_, batch, batch);
+        } else {
+            crypto::encrypt_blocks(key_, batch, batch);
+        }
+
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            xor_words(batch[j], offsets[j]);
+            if (decrypt) {
+                xor_words(checksum, batch[j]);
+            }
+        }
+    }
+}
+
+void OCB::crypt_chunk(std::span<Block> blocks, bool decrypt) noexcept {
+    const std::size_t ranges =
+        std::min(threads_, (blocks.size() + RANGE_BLOCKS - 1) / RANGE_BLOCKS);
+    if (ranges <= 1) {
+        crypt_blocks(blocks, blocks_, checksum_, decrypt);
+        blocks_ += blocks.size();
+        return;
+    }
+
+    // each range has a checksum of its own, XOR is order-free
+    std::vector<Block> checksums(ranges);
+    const std::size_t range_size = (blocks.size() + ranges - 1) / ranges;
+    {
+        std::vector<std::jthread> workers{};
+        for (std::size_t r = 0; r < ranges; ++r) {
+            const std::size_t begin = r * range_size;
+            const std::span<Block> range = blocks.subspan(
+                begin, std::min(range_size, blocks.size() - begin));
+
+            Block& checksum = checksums[r];
+            const auto run = [this, range, begin, &checksum, decrypt] {
+                crypt_blocks(range, blocks_ + begin, checksum, decrypt);
+            };
+            if (r + 1 < ranges) {
+                workers.emplace_back(run);
+            } else {
+                run();
+            }
+        }
+    }
+
+    for (const Block& checksum : checksums) {
+        xor_words(checksum_, checksum);
+    }
+    blocks_ += blocks.size();
+}
+
+void OCB::encrypt_chunk(std::span<Block> blocks) noexcept {
+    crypt_chunk(blocks, false);
+}
+
+void OCB::decrypt_chunk(std::span<Block> blocks) noexcept {
+    crypt_chunk(blocks, true);
+}
+
+void OCB::crypt_partial(Block& block, std::size_t remainder,
+                        bool decrypt) noexcept {
+    // Offset_* = Offset_m xor L_*, the pad is its encryption
+    const Block pad = crypto::encrypt(
+        nonce_offset_ ^ table_.offset(blocks_) ^ table_.star(), key_);
+
+    // the plaintext, 10* padded, goes into the checksum
+    Block padded{};
+    std::copy_n(block.begin(), remainder, padded.begin());
+    if (decrypt) {
+        padded ^= pad;
+        std::fill(padded.begin() + remainder, padded.end(), 0);
+    }
+    padded[remainder] = 0x80;
+    xor_words(checksum_, padded);
+
+    // the bytes after the block's end may be the tag, in `decrypt_fd`
+    for (std::size_t i = 0; i < remainder; ++i) {
+        block[i] ^= pad[i];
+    }
+    partial_ = true;
+}
+
+void OCB::encrypt_last(std::span<Block> blocks, std::size_t remainder) {
+    if (remainder == 0) {
+        crypt_chunk(blocks, false);
+        return;
+    }
+    crypt_chunk(blocks.first(blocks.size() - 1), false);
+    crypt_partial(blocks.back(), remainder, false);
+}
+
+void OCB::decrypt_last(std::span<Block> blocks, std::size_t remainder) {
+    if (remainder == 0) {
+        crypt_chunk(blocks, true);
+        return;
+    }
+    crypt_chunk(blocks.first(blocks.size() - 1), true);
+    crypt_partial(blocks.back(), remainder, true);
+}
+
+void OCB::hash_aad(std::span<const Block> blocks) noexcept {
+    std::array<Block, BATCH_BLOCKS> batch{};
+    Block offset = table_.offset(aad_blocks_);
+
+    for (std::size_t i = 0; i < blocks.size(); i += BATCH_BLOCKS) {
+        const std::size_t n = std::min(BATCH_BLOCKS, blocks.size() - i);
+        for (std::size_t j = 0; j < n; ++j) {
+            xor_words(offset, table_[std::countr_zero(++aad_blocks_)]);
+            batch[j] = blocks[i + j];
+            xor_words(batch[j], offset);
+        }
+        crypto::encrypt_blocks(key_, {batch.data(), n}, batch);
+
+        for (std::size_t j = 0; j < n; ++j) {
+            xor_words(aad_sum_, batch[j]);
+        }
+    }
+}
+
+void OCB::add_aad(std::span<const uint8_t> aad) noexcept {
+    // top up the partial block left by the previous call
+    if (aad_fill_ > 0) {
+        const std::size_t n = std::min(aad.size(), BLOCK_SIZE - aad_fill_);
+        std::copy_n(aad.begin(), n, aad_block_.begin() + aad_fill_);
+        aad_fill_ += n;
+        aad = aad.subspan(n);
+        if (aad_fill_ < BLOCK_SIZE) {
+            return;
+        }
+        hash_aad({&aad_block_, 1});
+        aad_fill_ = 0;
+    }
+
+    std::array<Block, BATCH_BLOCKS> batch{};
+    while (aad.size() >= BLOCK_SIZE) {
+        const std::size_t n = std::min(BATCH_BLOCKS, aad.size() / BLOCK_SIZE);
+        std::copy_n(aad.begin(), n * BLOCK_SIZE, batch[0].begin());
+        hash_aad({batch.data(), n});
+        aad = aad.subspan(n * BLOCK_SIZE);
+    }
+
+    std::copy(aad.begin(), aad.end(), aad_block_.begin());
+    aad_fill_ = aad.size();
+}
+
+void OCB::add_aad(std::istream& aad) {
+    std::vector<uint8_t> buffer(CHUNK_BLOCKS * BLOCK_SIZE);
+    while (aad) {
+        aad.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+        add_aad({buffer.data(), std::size_t(aad.gcount())});
+    }
+    if (aad.bad()) {
+        throw io::IOError{"failed to read additional data",
+                          errors::Error::Other};
+    }
+}
+
+std::vector<char> OCB::tag() noexcept {
+    // a partial last block of additional data is 10* padded and offset by
+    // L_* as well
+    if (aad_fill_ > 0) {
+        const Block offset = table_.offset(aad_blocks_) ^ table_.star();
+        std::fill(aad_block_.begin() + aad_fill_, aad_block_.end(), 0);
+        aad_block_[aad_fill_] = 0x80;
+        xor_words(aad_sum_, crypto::encrypt(aad_block_ ^ offset, key_));
+    }
+    aad_fill_ = 0;
+
+    Block offset = nonce_offset_ ^ table_.offset(blocks_);
+    if (partial_) {
+        xor_words(offset, table_.star());
+    }
+    const Block tag =
+        crypto::encrypt(checksum_ ^ offset ^ table_.dollar(), key_) ^
+        aad_sum_;
+
+    return {tag.begin(), tag.end()};
+}
+
 }  // namespace crypto::ciphermode
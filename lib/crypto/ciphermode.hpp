@@ -1,39 +1,124 @@
-#include <boost/multiprecision/cpp_int.hpp>
+#pragma once
+
 #include <crypto/crypto.hpp>
+#include <crypto/ghash.hpp>
 #include <crypto/key.hpp>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
 
 namespace crypto::ciphermode {
 
-using boost::multiprecision::uint128_t;
+// GCM blocks as integers, the first byte is the most significant
+using uint128_t = unsigned __int128;
 
-// don't worry about const qualifier for now.
-// TODO: fix qualifier when AES key is integrated
 class CipherMode {
     public:
         using AES = AesKey;
 
     protected:
-        AesKey& key_;
+        const RoundKeys& key_;
         std::istream& input_fd_;
         std::ostream& output_fd_;
         Block diffusion_block_;
 
+        // blocks read from `input_fd_` at a time
+        static constexpr std::size_t CHUNK_BLOCKS = 1024;
+
+        // `CHUNK_BLOCKS`, raised by modes that split a chunk across threads
+        std::size_t chunk_blocks_{CHUNK_BLOCKS};
+
+        // blocks handed to the batch cipher at a time, a full pass of the
+        // widest engine (bitsliced with AVX2)
+        static constexpr std::size_t BATCH_BLOCKS = 16;
+
         virtual void key_encrypt_inplace(Block& buf) noexcept;
         virtual void key_decrypt_inplace(Block& buf) noexcept;
 
+        // encrypt/decrypt a whole chunk of consecutive blocks. The default
+        // runs `encrypt`/`decrypt` on each block in turn, modes that can
+        // process blocks independently override these to use the batch
+        // cipher.
+        virtual void encrypt_chunk(std::span<Block> blocks) noexcept;
+        virtual void decrypt_chunk(std::span<Block> blocks) noexcept;
+
+        // compare `tag()` with the `tag_size()` bytes at `expected`, throws
+        // `io::IOError` when they differ
+        void check_tag(const uint8_t* expected);
+
+        // called while `encrypt_fd`/`decrypt_fd` wait for interactive
+        // input, to get work done before the data arrives
+        virtual void idle() noexcept {}
+
+        // Whether `encrypt_fd` pads the last block. Modes that do not
+        // (stream modes) get a partial last block through `encrypt_last`
+        // with only its leading bytes written, and any length to decrypt.
+        virtual bool padded() const noexcept { return true; }
+
+        // Make the next block `decrypt_chunk` gets block `block` of the
+        // payload, for `decrypt_range`. Modes whose blocks cannot be
+        // decrypted on their own keep the default and return false.
+        virtual bool seek_block(uint64_t) noexcept { return false; }
+
+        // Whole blocks `encrypt_fd` holds back until the input ends, for
+        // modes whose last blocks depend on where the message ends.
+        // `decrypt_fd` always holds back two.
+        virtual std::size_t tail_blocks() const noexcept { return 0; }
+
+        // The last chunk of an unpadded mode: only the first `remainder`
+        // bytes of its last block count, or all of them when 0, and only
+        // those may change, the tag can follow them. Default to
+        // `encrypt_chunk`/`decrypt_chunk`, modes that cannot end there
+        // throw `io::IOError`.
+        virtual void encrypt_last(std::span<Block> blocks,
+                                  std::size_t remainder);
+        virtual void decrypt_last(std::span<Block> blocks,
+                                  std::size_t remainder);
+
+    private:
+        // see `set_interactive`
+        bool interactive_{false};
+
+        // Read up to `n` bytes of input to `dst`, returns the number of
+        // bytes read. Interactive, it only waits for the first byte and
+        // returns 0 once the input ends.
+        std::size_t read_input(uint8_t* dst, std::size_t n);
+
     public:
-        CipherMode(AES& key, std::istream& in, std::ostream& out, Block& iv);
+        CipherMode(const AES& key, std::istream& in, std::ostream& out,
+                   const Block& iv);
         ~CipherMode() = default;
 
         virtual void encrypt(Block&) noexcept = 0;
         virtual void decrypt(Block&) noexcept = 0;
 
-        void encrypt_fd() noexcept;
+        void encrypt_fd();
         void decrypt_fd();
 
+        // Take input as it arrives rather than in whole chunks, and flush
+        // the output after each write, for pipes where a record should not
+        // wait for the ones after it. The output is the same.
+        void set_interactive(bool interactive) noexcept;
+
+        // Decrypt only bytes [offset, offset + length) of the plaintext,
+        // cut at its end, reading just the blocks they are in: the input
+        // is at the start of the ciphertext and must be seekable. CTR and
+        // GCM can do it, the others throw `io::IOError`, as does an input
+        // that is too short.
+        //
+        // Nothing is authenticated. A GCM tag covers the whole message and
+        // is not checked here, so the bytes written may have been tampered
+        // with; `GCM::verify_fd` over the whole ciphertext, or a Merkle
+        // container, is what gives integrity.
+        void decrypt_range(uint64_t offset, uint64_t length);
+
         // final call to compute the authenticated tag.
         virtual std::vector<char> tag() noexcept { return {}; }
 
+        // bytes of authentication tag that follow the ciphertext
+        virtual std::size_t tag_size() const noexcept { return 0; }
+
         // don't need these
         CipherMode() = delete;
         CipherMode(CipherMode&) = delete;
@@ -44,16 +129,183 @@ class CipherMode {
 
 class ECB : public CipherMode {
     public:
-        ECB(AES& key, std::istream& in, std::ostream& out, Block& iv);
+        ECB(const AES& key, std::istream& in, std::ostream& out, Block& iv);
         void encrypt(Block& buf) noexcept override;
         void decrypt(Block& buf) noexcept override;
+
+    protected:
+        void encrypt_chunk(std::span<Block> blocks) noexcept override;
+        void decrypt_chunk(std::span<Block> blocks) noexcept override;
 };
 
 class CBC : public CipherMode {
+    private:
+        // as in `GCM`, at least 1 MiB per thread
+        static constexpr std::size_t RANGE_BLOCKS = std::size_t(1) << 16;
+        const std::size_t threads_;
+
+    public:
+        // `threads` only applies to decryption
+        CBC(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+            std::size_t threads = 1);
+        void encrypt(Block& buf) noexcept override;
+        void decrypt(Block& buf) noexcept override;
+
+    protected:
+        // encryption chains every block on the previous one, only
+        // decryption can be batched. Each plaintext block only needs two
+        // ciphertext blocks, so a chunk is also split across threads like
+        // CTR.
+        void decrypt_chunk(std::span<Block> blocks) noexcept override;
+
+    private:
+        // decrypt `blocks` in place, `BATCH_BLOCKS` at a time, the first
+        // one chained on `previous`. Returns the last ciphertext block.
+        Block chain_decrypt(std::span<Block> blocks,
+                            Block previous) const noexcept;
+};
+
+// CTR
+namespace ctr_utils {
+
+// increment `block` as one big-endian 128-bit counter, wrapping
+void inc_counter(Block&) noexcept;
+
+// `inc_counter` `n` times
+void add_counter(Block&, uint64_t n) noexcept;
+
+}  // namespace ctr_utils
+
+// CTR: the keystream is the encryption of consecutive counter blocks, the
+// whole `iv` block counting as one big-endian 128-bit counter. There is no
+// padding, the ciphertext is exactly as long as the plaintext, and no tag,
+// integrity has to come from elsewhere. Blocks are independent: chunks go
+// through the batch cipher, split across threads like GCM, and the stream
+// can start at any block of the message.
+class CTR : public CipherMode {
+    private:
+        const Block iv_;
+
+        // as in `GCM`, at least 1 MiB per thread
+        static constexpr std::size_t RANGE_BLOCKS = std::size_t(1) << 16;
+        const std::size_t threads_;
+
+    public:
+        CTR(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+            std::size_t threads = 1);
+        void encrypt(Block& buf) noexcept override;
+        void decrypt(Block& buf) noexcept override;
+
+        // Start at block `block` of the message: its counter is `iv` plus
+        // `block`. Call before the input.
+        void seek(uint64_t block) noexcept;
+
+    protected:
+        void encrypt_chunk(std::span<Block> blocks) noexcept override;
+        void decrypt_chunk(std::span<Block> blocks) noexcept override;
+        bool padded() const noexcept override { return false; }
+        bool seek_block(uint64_t block) noexcept override;
+
+    private:
+        // XOR the keystream of the counters from `counter` into `blocks`,
+        // `BATCH_BLOCKS` at a time
+        void apply_keystream(std::span<Block> blocks,
+                             Block& counter) const noexcept;
+};
+
+// XTS
+namespace xts_utils {
+
+// multiply a tweak by x in GF(2^128), its first byte the least significant
+void mul_alpha(Block&) noexcept;
+
+}  // namespace xts_utils
+
+// XTS-AES (IEEE 1619, NIST SP 800-38E): the input is a run of data units
+// (sectors) of `unit_size` bytes, the last one may be shorter. Each block is
+// encrypted between two XORs of its tweak, the encryption of the unit
+// number under a second key, times x to the power of the block's place in
+// the unit. There is no IV to store and no padding: a unit that does not
+// end on a block boundary steals the tail of the block before it, so the
+// ciphertext is exactly as long as the plaintext. There is no tag either.
+// Units are independent: chunks are split across threads like CTR, and any
+// one unit can be rewritten in place with `encrypt_unit`.
+class XTS : public CipherMode {
+    private:
+        const RoundKeys& tweak_key_;
+        const std::size_t unit_blocks_;
+
+        // as in `GCM`, at least 1 MiB per thread
+        static constexpr std::size_t RANGE_BLOCKS = std::size_t(1) << 16;
+        const std::size_t threads_;
+
+        // the data unit of the next block, and the block's place in it
+        uint64_t unit_{0};
+        std::size_t index_{0};
+
     public:
-        CBC(AES& key, std::istream& in, std::ostream& out, Block& iv);
+        static constexpr std::size_t DEFAULT_UNIT_SIZE = 512;
+
+        // IEEE 1619 caps a data unit at 2^20 blocks
+        static constexpr std::size_t MAX_UNIT_SIZE = BLOCK_SIZE << 20;
+
+        // `key` encrypts the data and `tweak_key` the unit numbers, the two
+        // halves of an XTS key. `unit_size` is a multiple of 16, up to
+        // `MAX_UNIT_SIZE`.
+        XTS(const AES& key, const AES& tweak_key, std::istream& in,
+            std::ostream& out, std::size_t unit_size = DEFAULT_UNIT_SIZE,
+            std::size_t threads = 1);
         void encrypt(Block& buf) noexcept override;
         void decrypt(Block& buf) noexcept override;
+
+        // Start at data unit `unit`: the input is that unit onwards. Call
+        // before the input.
+        void seek(uint64_t unit) noexcept;
+
+        // Encrypt/decrypt data unit `unit` on its own, in place, to update
+        // one sector of an image. `data` is the whole unit, from one block
+        // up to `unit_size` bytes, throws `io::IOError` otherwise.
+        void encrypt_unit(uint64_t unit, std::span<uint8_t> data) const;
+        void decrypt_unit(uint64_t unit, std::span<uint8_t> data) const;
+
+    protected:
+        void encrypt_chunk(std::span<Block> blocks) noexcept override;
+        void decrypt_chunk(std::span<Block> blocks) noexcept override;
+        bool padded() const noexcept override { return false; }
+
+        // the block before a partial one is needed to steal from
+        std::size_t tail_blocks() const noexcept override { return 1; }
+        void encrypt_last(std::span<Block> blocks,
+                          std::size_t remainder) override;
+        void decrypt_last(std::span<Block> blocks,
+                          std::size_t remainder) override;
+
+    private:
+        // the tweak of block `index` of data unit `unit`
+        Block tweak(uint64_t unit, std::size_t index) const noexcept;
+
+        // XEX over `blocks`, the first of them block `index` of data unit
+        // `unit`, `BATCH_BLOCKS` at a time
+        void crypt_blocks(std::span<Block> blocks, uint64_t unit,
+                          std::size_t index, bool decrypt) const noexcept;
+
+        // `crypt_blocks` from the current position, split across
+        // `threads_`, then move past `blocks`
+        void crypt_chunk(std::span<Block> blocks, bool decrypt) noexcept;
+
+        // Ciphertext stealing: `full` is block `index` of data unit `unit`
+        // and the first `remainder` bytes of `partial` end the unit
+        void steal(Block& full, Block& partial, std::size_t remainder,
+                   uint64_t unit, std::size_t index,
+                   bool decrypt) const noexcept;
+
+        // `encrypt_last`/`decrypt_last`
+        void crypt_last(std::span<Block> blocks, std::size_t remainder,
+                        bool decrypt);
+
+        // `encrypt_unit`/`decrypt_unit`
+        void crypt_unit(uint64_t unit, std::span<uint8_t> data,
+                        bool decrypt) const;
 };
 
 // GCM
@@ -65,7 +317,17 @@ constexpr std::size_t IV_SIZE = 12;
 // of `block`
 void inc_counter(Block&) noexcept;
 
+// `inc_counter` `n` times
+void add_counter(Block&, uint64_t n) noexcept;
+
 class AuthTag {
+    public:
+        // GHASH multiplication tables, 256 bytes or 4 KiB per key
+        enum class Tables {
+            Bits4,
+            Bits8,
+        };
+
     private:
         // Param for Galois auth tag
         const uint128_t H_;
@@ -73,48 +335,380 @@ class AuthTag {
         // XOR last ciphertext to make the tag
         const Block counter_0_;
 
-        // starts with 0, since we're not supporting
-        // authenticated data right now.
-        uint128_t tag_{0};
+        // GHASH of the additional data and the ciphertext so far
+        ghash::Element tag_{};
+
+        // `galois_multiply` walks `H` from its least significant bit, which
+        // is the GCM multiplication by `H` with its 128 bits reversed. The
+        // tables are built for that value, so the tags stay the same.
+        // PCLMULQDQ replaces the 4 KiB tables when the CPU has it.
+        const ghash::Table4 table4_;
+        const std::unique_ptr<const ghash::Clmul> clmul_;
+        const std::unique_ptr<const ghash::Table8> table8_;
+
+        // the key the tables are built for, to combine partial hashes
+        const ghash::Element key_;
 
     public:
-        AuthTag(Block H, Block counter_0)
-            : H_{AuthTag::bytes_to_uint128_t(H)}, counter_0_{counter_0} {};
+        AuthTag(Block H, Block counter_0, Tables tables = Tables::Bits4);
 
         const uint128_t& H() const noexcept;
 
-        void update_tag(const Block& ciphertext);
+        // tag = (tag ^ ciphertext) * H, with the tables
+        void update_tag(const Block& ciphertext) noexcept;
+
+        // `update_tag` on each block in turn, eight blocks per reduction
+        // with PCLMULQDQ
+        void update_tag(std::span<const Block> ciphertext) noexcept;
+
+        // `update_tag` on an independent `state`, for partial hashes of
+        // ranges that are processed in parallel
+        void hash(ghash::Element& state,
+                  std::span<const Block> ciphertext) const noexcept;
+
+        // Append the hash of a range of `blocks` blocks, computed by `hash`
+        // from a zero state: tag = tag * H^blocks ^ partial
+        void combine(const ghash::Element& partial,
+                     uint64_t blocks) noexcept;
+
+        // for the stitched AES-GCM loop, which folds blocks into `state()`
+        // itself. Null without PCLMULQDQ.
+        const ghash::Clmul* clmul() const noexcept { return clmul_.get(); }
+        ghash::Element& state() noexcept { return tag_; }
+        const ghash::Element& state() const noexcept { return tag_; }
         uint128_t counter0() const noexcept;
 
         // convert 16 byte array in to a 128 bit unsigned integer
-        static uint128_t bytes_to_uint128_t(const Block&);
-        static void uint128_t_to_bytes(const uint128_t& n, Block&);
+        static uint128_t bytes_to_uint128_t(const Block&) noexcept;
+        static void uint128_t_to_bytes(const uint128_t& n, Block&) noexcept;
         uint128_t value() const noexcept;
-        static uint128_t galois_multiply(const uint128_t&, const uint128_t&);
+
+        // bit-serial reference multiplication
+        static uint128_t galois_multiply(const uint128_t&,
+                                         const uint128_t&) noexcept;
+};
+
+// Keystream computed ahead of the data: a ring of up to `capacity` counter
+// blocks encrypted before the blocks they go with arrive
+class Keystream {
+    private:
+        const RoundKeys& key_;
+        std::vector<Block> ring_;
+        std::size_t head_{0};
+        std::size_t size_{0};
+
+        // the first counter not in `ring_` yet
+        Block counter_;
+
+    public:
+        Keystream(const RoundKeys& key, const Block& counter,
+                  std::size_t capacity);
+
+        // encrypt counters until the ring is full
+        void fill() noexcept;
+
+        // XOR the next keystream blocks into `blocks`, filling the ring
+        // whenever it runs dry
+        void apply(std::span<Block> blocks) noexcept;
+
+        // blocks ready
+        std::size_t size() const noexcept { return size_; }
+
+        // The counter after the ready blocks. Once they are used up, the
+        // counter can be taken further elsewhere and handed back with
+        // `restart`.
+        const Block& counter() const noexcept { return counter_; }
+        void restart(const Block& counter) noexcept;
 };
 
 }  // namespace gcm_utils
 
+// GHASH of one shard of a message, from a zero state, and where the shard
+// sits in the message. Written after the ciphertext of a `GCMShard`.
+struct ShardState {
+        // bytes of the big-endian encoding
+        static constexpr std::size_t SIZE = 2 * BLOCK_SIZE;
+
+        ghash::Element hash;
+        uint64_t first_block;
+        uint64_t payload_len;
+
+        void store(uint8_t* bytes) const noexcept;
+        static ShardState load(const uint8_t* bytes) noexcept;
+};
+
 class GCM : public CipherMode {
     private:
         gcm_utils::AuthTag tag_;
         uint64_t payload_len_{0};
         uint64_t aad_len_{0};
 
+        // trailing partial block of additional data, hashed zero padded
+        // once the payload starts
+        Block aad_block_{};
+        std::size_t aad_fill_{0};
+
+        // Chunks are split into contiguous ranges of at least `RANGE_BLOCKS`
+        // (1 MiB), one per thread. Each thread runs CTR from its own start
+        // counter and hashes its range from zero, the partial hashes are
+        // combined in order, so the output is the same for any count.
+        static constexpr std::size_t RANGE_BLOCKS = std::size_t(1) << 16;
+        const std::size_t threads_;
+
+        // see `set_padded`
+        bool padded_{true};
+
+        // see `prefetch`
+        std::optional<gcm_utils::Keystream> keystream_{};
+
+        // the counter of the first payload block
+        Block payload_counter_{};
+
     public:
-        GCM(AES& key, std::istream& in, std::ostream& out, Block& iv);
+        GCM(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+            std::size_t threads = 1);
         void encrypt(Block& buf) noexcept override;
         void decrypt(Block& buf) noexcept override;
         std::vector<char> tag() noexcept override;
+        std::size_t tag_size() const noexcept override { return BLOCK_SIZE; }
+
+        // Additional authenticated data, in as many pieces as needed, all
+        // before the payload. Decryption needs the same bytes for the tag to
+        // match. Whole blocks are folded into GHASH straight away.
+        void add_aad(std::span<const uint8_t> aad) noexcept;
+
+        // `add_aad` with everything up to the end of `aad`, throws
+        // `io::IOError` when reading fails
+        void add_aad(std::istream& aad);
+
+        // Check the tag at the end of the ciphertext without decrypting:
+        // only GHASH runs over the input, and nothing is written. Throws
+        // `io::IOError` like `decrypt_fd` when the tag does not match.
+        void verify_fd();
+
+        // Merge: append a shard encrypted by `GCMShard` with the same key
+        // and IV, in message order, then take the `tag()`. The additional
+        // data, if any, goes in before the first shard. Throws
+        // `io::IOError` unless the shard starts where the last one ended.
+        void append_shard(const ShardState& shard);
+
+        // Without padding, for containers that know where the message ends:
+        // the message must then be whole blocks, and decryption gives them
+        // back as they are. Padded by default.
+        void set_padded(bool padded) noexcept { padded_ = padded; }
+
+        // Keep up to `blocks` counter blocks encrypted ahead of the payload,
+        // refilled in `idle()` and whenever they run out, so a block that
+        // arrives costs only the XOR and GHASH. Chunks are then no longer
+        // split across threads. Call before the payload.
+        void prefetch(std::size_t blocks);
+
+    protected:
+        void encrypt_chunk(std::span<Block> blocks) noexcept override;
+        void decrypt_chunk(std::span<Block> blocks) noexcept override;
+        void idle() noexcept override;
+        bool padded() const noexcept override { return padded_; }
+        bool seek_block(uint64_t block) noexcept override;
+
+        // move the counter `blocks` blocks ahead, without hashing
+        void skip_blocks(uint64_t blocks) noexcept;
+
+        // the hash of the payload so far, from a zero state
+        ShardState shard_state(uint64_t first_block) const noexcept;
 
     private:
+        // what `crypt_range` does to the blocks besides hashing them
+        enum class Pass : char {
+            Encrypt,
+            Decrypt,
+            Verify,
+        };
+
+        // hash the partial block of additional data, if any
+        void pad_aad() noexcept;
+
         // Since the encryption/decryption of payload is the
         // same, only the auth tag is slightly different...
         void encrypt_general(Block& block) noexcept;
 
+        // XOR the keystream of `blocks.size()` counters from `counter` into
+        // `blocks`, at most `BATCH_BLOCKS` at a time
+        void apply_keystream(std::span<Block> blocks,
+                             Block& counter) const noexcept;
+
+        // CTR from `counter` and GHASH into `state` over a range in one
+        // pass. Decryption hashes each batch before the keystream goes in,
+        // encryption after, verification only hashes. With AES-NI and
+        // PCLMULQDQ, `aesgcm` interleaves CTR and GHASH per block.
+        template <Pass P>
+        void crypt_range(std::span<Block> blocks, Block& counter,
+                         ghash::Element& state) const noexcept;
+
+        // `crypt_range` over a chunk, split across `threads_`
+        template <Pass P>
+        void crypt_chunk(std::span<Block> blocks) noexcept;
+
         // To encrypt counter 0 for auth tag, and to
-        // initialize `H` multiplication variable
+        // initialize `H` multiplication variable. Only runs the counter, it
+        // is called before `tag_` exists.
         Block encrypt_cp(const Block& block) noexcept;
 };
 
+// One block-aligned slice of a GCM message, encrypted on its own: the
+// counter starts at block `first_block` of the message and GHASH at zero.
+// The output ends with the `ShardState` instead of a tag, `GCM::append_shard`
+// merges the shards into the tag a single `GCM` stream would give.
+//
+// Only the last shard may end off a block boundary, it is padded like the
+// end of a `GCM` stream.
+class GCMShard : public GCM {
+    private:
+        const uint64_t first_block_;
+
+    public:
+        GCMShard(const AES& key, std::istream& in, std::ostream& out,
+                 Block& iv, uint64_t first_block, std::size_t threads = 1);
+
+        // the `ShardState`, `ShardState::SIZE` bytes
+        std::vector<char> tag() noexcept override;
+        std::size_t tag_size() const noexcept override {
+            return ShardState::SIZE;
+        }
+};
+
+// GMAC: GCM with the whole message as additional data and no payload, for
+// data that needs tamper evidence but no confidentiality. Only GHASH runs
+// over the message, the output is the 16-byte tag.
+class GMAC {
+    private:
+        std::istream& input_fd_;
+
+        // nothing goes through the cipher, so nothing is written
+        std::ostream null_output_{nullptr};
+
+        GCM gcm_;
+
+    public:
+        // reads the message from `in`, `iv` is the nonce as in `GCM`
+        GMAC(const CipherMode::AES& key, std::istream& in, Block& iv);
+
+        // the tag of the whole of `in`
+        Block tag_fd();
+
+        // throws `io::IOError` unless `expected` is the tag of `in`
+        void verify_fd(const Block& expected);
+};
+
+// OCB
+namespace ocb_utils {
+
+// RFC 7253 `double`: multiply by x in GF(2^128), the first byte the most
+// significant
+Block twice(const Block&) noexcept;
+
+// The offsets RFC 7253 derives from a key: L_* = E(0), L_$ = double(L_*)
+// and L_i = double^(i + 1)(L_$), computed once with the key.
+class LTable {
+    public:
+        // L_i for i < 64, enough for any block number
+        static constexpr std::size_t SIZE = 64;
+
+        explicit LTable(const RoundKeys& key) noexcept;
+
+        const Block& star() const noexcept { return star_; }
+        const Block& dollar() const noexcept { return dollar_; }
+        const Block& operator[](std::size_t i) const noexcept { return l_[i]; }
+
+        // The XOR of L_ntz(j) for j = 1..`blocks`: the offset of block
+        // `blocks` less the nonce's. It takes the L_i at the set bits of
+        // the Gray code of `blocks`, so a range can start anywhere.
+        Block offset(uint64_t blocks) const noexcept;
+
+    private:
+        Block star_;
+        Block dollar_;
+        std::array<Block, SIZE> l_;
+};
+
+}  // namespace ocb_utils
+
+// OCB3 (RFC 7253) with a 96-bit nonce and a 128-bit tag: an AEAD that
+// encrypts and authenticates with one AES call per block. Each block is
+// encrypted between two XORs of its offset, and the tag is the encryption
+// of the plaintext checksum, so there is no GF(2^128) multiplication and
+// blocks are independent: chunks go through the batch cipher, split
+// across threads like GCM. There is no padding, the ciphertext is as long
+// as the plaintext, followed by the tag.
+class OCB : public CipherMode {
+    private:
+        const ocb_utils::LTable table_;
+
+        // Offset_0, from the nonce
+        const Block nonce_offset_;
+
+        // as in `GCM`, at least 1 MiB per thread
+        static constexpr std::size_t RANGE_BLOCKS = std::size_t(1) << 16;
+        const std::size_t threads_;
+
+        // payload blocks so far and the XOR of their plaintext, and whether
+        // a partial block ended the payload
+        uint64_t blocks_{0};
+        Block checksum_{};
+        bool partial_{false};
+
+        // HASH(K, A) of the additional data so far, and its trailing
+        // partial block
+        uint64_t aad_blocks_{0};
+        Block aad_sum_{};
+        Block aad_block_{};
+        std::size_t aad_fill_{0};
+
+    public:
+        // `iv` holds the 12-byte nonce, as in `GCM`
+        OCB(const AES& key, std::istream& in, std::ostream& out, Block& iv,
+            std::size_t threads = 1);
+        void encrypt(Block& buf) noexcept override;
+        void decrypt(Block& buf) noexcept override;
+        std::vector<char> tag() noexcept override;
+        std::size_t tag_size() const noexcept override { return BLOCK_SIZE; }
+
+        // Additional authenticated data, in as many pieces as needed, at
+        // any time before `tag()`. Decryption needs the same bytes for the
+        // tag to match.
+        void add_aad(std::span<const uint8_t> aad) noexcept;
+
+        // `add_aad` with everything up to the end of `aad`, throws
+        // `io::IOError` when reading fails
+        void add_aad(std::istream& aad);
+
+    protected:
+        void encrypt_chunk(std::span<Block> blocks) noexcept override;
+        void decrypt_chunk(std::span<Block> blocks) noexcept override;
+        bool padded() const noexcept override { return false; }
+        void encrypt_last(std::span<Block> blocks,
+                          std::size_t remainder) override;
+        void decrypt_last(std::span<Block> blocks,
+                          std::size_t remainder) override;
+
+    private:
+        // Offset_0 of the nonce in `iv`
+        Block nonce_offset(const Block& iv) const noexcept;
+
+        // Encrypt/decrypt `blocks`, the first of them payload block
+        // `first + 1`, `BATCH_BLOCKS` at a time, and XOR their plaintext
+        // into `checksum`
+        void crypt_blocks(std::span<Block> blocks, uint64_t first,
+                          Block& checksum, bool decrypt) const noexcept;
+
+        // `crypt_blocks` over a chunk, split across `threads_`
+        void crypt_chunk(std::span<Block> blocks, bool decrypt) noexcept;
+
+        // the partial block at the end of the payload
+        void crypt_partial(Block& block, std::size_t remainder,
+                           bool decrypt) noexcept;
+
+        // fold whole blocks of additional data into `aad_sum_`
+        void hash_aad(std::span<const Block> blocks) noexcept;
+};
+
 }  // namespace crypto::ciphermode
@@ -0,0 +1,67 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace crypto::cpu {
+
+// x86 feature bits, CPUID leaf 1, register ECX
+inline constexpr unsigned int ECX_PCLMULQDQ = 1u << 1;
+inline constexpr unsigned int ECX_SSSE3 = 1u << 9;
+inline constexpr unsigned int ECX_SSE41 = 1u << 19;
+inline constexpr unsigned int ECX_AES = 1u << 25;
+inline constexpr unsigned int ECX_OSXSAVE = 1u << 27;
+
+// CPUID leaf 7, register EBX
+inline constexpr unsigned int EBX7_AVX2 = 1u << 5;
+
+// returns ECX of CPUID leaf 1, or 0 when not on x86
+inline unsigned int cpuid_features() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return ecx;
+    }
+#endif
+    return 0;
+}
+
+// AESENC/AESDEC and friends, queried once per process
+inline bool has_aesni() noexcept {
+    static const bool supported = [] {
+        const unsigned int required = ECX_AES | ECX_SSE41;
+        return (cpuid_features() & required) == required;
+    }();
+    return supported;
+}
+
+// PCLMULQDQ, plus PSHUFB for the byte order of GHASH
+inline bool has_pclmul() noexcept {
+    static const bool supported = [] {
+        const unsigned int required = ECX_PCLMULQDQ | ECX_SSSE3;
+        return (cpuid_features() & required) == required;
+    }();
+    return supported;
+}
+
+// 256-bit integer vectors, with the YMM state enabled by the OS
+inline bool has_avx2() noexcept {
+    static const bool supported = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        if ((cpuid_features() & ECX_OSXSAVE) == 0 ||
+            !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        unsigned int xcr0, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+        return (ebx & EBX7_AVX2) != 0 && (xcr0 & 0x6) == 0x6;
+#else
+        return false;
+#endif
+    }();
+    return supported;
+}
+
+}  // namespace crypto::cpu
@@ -0,0 +1,104 @@
+#include <crypto/ghash.hpp>
+
+namespace crypto::ghash {
+
+namespace {
+
+// x * p(x), the multiplication by x is a shift towards the end of the block
+// and x^128 folds back in as x^7 + x^2 + x + 1
+constexpr Element times_x(const Element& p) noexcept {
+    const uint64_t carry = (p.lo & 1) ? 0xe100000000000000 : 0;
+    return {(p.hi >> 1) ^ carry, (p.hi << 63) | (p.lo >> 1)};
+}
+
+// What the `Bits` low bits of an element add to the top 16 bits when the
+// element is shifted `Bits` places towards the end: the reduction of the
+// bits shifted out, so the shift itself can stay a plain 64-bit shift.
+template <std::size_t Bits>
+constexpr std::array<uint16_t, (1 << Bits)> make_reduction() {
+    std::array<uint16_t, (1 << Bits)> result{};
+    for (std::size_t r = 0; r < result.size(); ++r) {
+        Element p{0, r};
+        for (std::size_t i = 0; i < Bits; ++i) {
+            p = times_x(p);
+        }
+        result[r] = p.hi >> 48;
+    }
+    return result;
+}
+
+constexpr auto reduce4 = make_reduction<4>();
+constexpr auto reduce8 = make_reduction<8>();
+
+static_assert(reduce4[1] == 0x1c20 && reduce4[8] == 0xe100);
+static_assert(reduce8[1] == 0x01c2 && reduce8[0x80] == 0xe100);
+
+// `m[i]` = H * i for the `N`-bit polynomials i, most significant bit first
+template <std::size_t N>
+void fill_multiples(std::array<Element, N>& m, const Element& h) noexcept {
+    m[0] = {0, 0};
+    m[N / 2] = h;
+    for (std::size_t i = N / 4; i > 0; i /= 2) {
+        m[i] = times_x(m[2 * i]);
+    }
+    for (std::size_t i = 2; i < N; i *= 2) {
+        for (std::size_t j = 1; j < i; ++j) {
+            m[i + j] = m[i] ^ m[j];
+        }
+    }
+}
+
+inline uint8_t byte_at(const Element& x, std::size_t i) noexcept {
+    return i < 8 ? x.hi >> (56 - 8 * i) : x.lo >> (120 - 8 * i);
+}
+
+}  // namespace
+
+Table4::Table4(const Element& h) noexcept { fill_multiples(m_, h); }
+
+Element Table4::multiply(const Element& x) const noexcept {
+    // Horner's rule from the last nibble: z = z * x^4 + H * nibble
+    Element z{};
+    for (std::size_t i = BLOCK_SIZE; i-- > 0;) {
+        const uint8_t byte = byte_at(x, i);
+        for (const uint8_t nibble : {uint8_t(byte & 0xf), uint8_t(byte >> 4)}) {
+            const uint8_t rem = z.lo & 0xf;
+            z.lo = (z.hi << 60) | (z.lo >> 4);
+            z.hi = (z.hi >> 4) ^ (uint64_t(reduce4[rem]) << 48);
+            z = z ^ m_[nibble];
+        }
+    }
+    return z;
+}
+
+Table8::Table8(const Element& h) noexcept { fill_multiples(m_, h); }
+
+Element Table8::multiply(const Element& x) const noexcept {
+    // Horner's rule from the last byte: z = z * x^8 + H * byte
+    Element z{};
+    for (std::size_t i = BLOCK_SIZE; i-- > 0;) {
+        const uint8_t rem = z.lo & 0xff;
+        z.lo = (z.hi << 56) | (z.lo >> 8);
+        z.hi = (z.hi >> 8) ^ (uint64_t(reduce8[rem]) << 48);
+        z = z ^ m_[byte_at(x, i)];
+    }
+    return z;
+}
+
+Element multiply(const Element& x, const Element& y) noexcept {
+    return Table4{y}.multiply(x);
+}
+
+Element power(const Element& h, uint64_t n) noexcept {
+    Element result = ONE;
+    Element square = h;
+    for (; n > 0; n >>= 1) {
+        if (n & 1) {
+            result = multiply(result, square);
+        }
+        square = multiply(square, square);
+    }
+    return result;
+}
+
+}  // namespace crypto::ghash
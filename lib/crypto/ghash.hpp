@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <crypto/crypto.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// GHASH multiplication in GF(2^128) with Shoup's tables: the multiples of
+// the hash key `H` are computed once per key, after which a multiplication
+// is one lookup and one shift per 4 (or 8) bits of the other operand.
+//
+// Elements are in the GCM bit order, the most significant bit of the first
+// byte is the coefficient of x^0.
+namespace crypto::ghash {
+
+// a block as two big-endian halves
+struct Element {
+        uint64_t hi;
+        uint64_t lo;
+};
+
+// between host and big-endian byte order
+inline uint64_t big_endian(uint64_t x) noexcept {
+    if constexpr (std::endian::native == std::endian::little) {
+        return __builtin_bswap64(x);
+    }
+    return x;
+}
+
+inline Element load(const Block& block) noexcept {
+    uint64_t halves[2];
+    std::memcpy(halves, block.data(), sizeof(halves));
+    return {big_endian(halves[0]), big_endian(halves[1])};
+}
+
+inline void store(const Element& element, Block& block) noexcept {
+    const uint64_t halves[2]{big_endian(element.hi), big_endian(element.lo)};
+    std::memcpy(block.data(), halves, sizeof(halves));
+}
+
+inline Element operator^(const Element& l, const Element& r) noexcept {
+    return {l.hi ^ r.hi, l.lo ^ r.lo};
+}
+
+// the multiplicative identity, x^0
+inline constexpr Element ONE{uint64_t(1) << 63, 0};
+
+// x * y, building a `Table4` for `y`. For the odd multiplication outside
+// the bulk loop.
+Element multiply(const Element& x, const Element& y) noexcept;
+
+// h^n, square and multiply
+Element power(const Element& h, uint64_t n) noexcept;
+
+// H times every 4-bit polynomial, 256 bytes
+class Table4 {
+    public:
+        explicit Table4(const Element& h) noexcept;
+
+        // x * H
+        Element multiply(const Element& x) const noexcept;
+
+    private:
+        std::array<Element, 16> m_;
+};
+
+// H times every 8-bit polynomial, 4 KiB. Half the lookups of `Table4`, for
+// long messages where the bigger table stays in cache.
+class Table8 {
+    public:
+        explicit Table8(const Element& h) noexcept;
+
+        // x * H
+        Element multiply(const Element& x) const noexcept;
+
+    private:
+        std::array<Element, 256> m_;
+};
+
+// Carry-less multiplication with PCLMULQDQ, only construct it when
+// `cpu::has_pclmul()` holds. Keeps H^1..H^8, so eight blocks are
+// multiplied with Karatsuba and folded into a single reduction.
+class Clmul {
+    public:
+        static constexpr std::size_t POWERS = 8;
+
+        explicit Clmul(const Element& h) noexcept;
+
+        // state = (...((state ^ blocks[0]) * H ^ blocks[1]) * H ...) * H
+        void update(Element& state, const Block* blocks,
+                    std::size_t n) const noexcept;
+
+        // H^(i + 1) at index i, and the XOR of its two halves for the
+        // middle Karatsuba product, as 16-byte aligned `__m128i`
+        const Block* powers() const noexcept { return powers_.data(); }
+        const Block* karatsuba() const noexcept { return karatsuba_.data(); }
+
+    private:
+        alignas(16) std::array<Block, POWERS> powers_;
+        alignas(16) std::array<Block, POWERS> karatsuba_;
+};
+
+}  // namespace crypto::ghash
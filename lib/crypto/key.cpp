@@ -0,0 +1,125 @@
+#include <crypto/aesni.hpp>
+#include <crypto/bitslice.hpp>
+#include <crypto/cpu.hpp>
+#include <crypto/key.hpp>
+#include <crypto/tables.hpp>
+
+namespace crypto {
+
+namespace {
+
+// multiplication by x in GF(2^8), the reduction masked in rather than
+// branched on
+constexpr uint8_t xtime(uint8_t a) noexcept {
+    return uint8_t((a << 1) ^ (0x1b & -(a >> 7)));
+}
+
+// InvMixColumns of a single round key, with shifts and XORs: the
+// `multiply_by_*` tables would be indexed by key bytes
+Block inv_mix_columns(const Block& key) noexcept {
+    Block result{};
+    for (std::size_t c = 0; c < BLOCK_SIZE; c += 4) {
+        // 9, 11, 13 and 14 times each byte of the column, from its
+        // doublings
+        uint8_t m9[4]{}, m11[4]{}, m13[4]{}, m14[4]{};
+        for (std::size_t r = 0; r < 4; ++r) {
+            const uint8_t a = key[c + r];
+            const uint8_t a2 = xtime(a);
+            const uint8_t a4 = xtime(a2);
+            const uint8_t a8 = xtime(a4);
+            m9[r] = a8 ^ a;
+            m11[r] = a8 ^ a2 ^ a;
+            m13[r] = a8 ^ a4 ^ a;
+            m14[r] = a8 ^ a4 ^ a2;
+        }
+
+        result[c] = m14[0] ^ m11[1] ^ m13[2] ^ m9[3];
+        result[c + 1] = m9[0] ^ m14[1] ^ m11[2] ^ m13[3];
+        result[c + 2] = m13[0] ^ m9[1] ^ m14[2] ^ m11[3];
+        result[c + 3] = m11[0] ^ m13[1] ^ m9[2] ^ m14[3];
+    }
+    return result;
+}
+
+}  // namespace
+
+RoundKeys::RoundKeys(const std::vector<uint8_t>& input_key) {
+    switch (input_key.size()) {
+        case 16:
+            rounds_ = 10;
+            break;
+        case 24:
+            rounds_ = 12;
+            break;
+        case 32:
+            rounds_ = 14;
+            break;
+        default:
+            throw KeyError(std::format("invalid key. length: {} bytes",
+                                       input_key.size()));
+    }
+
+    uint8_t* key = enc_[0].data();
+
+    if (cpu::has_aesni()) {
+        aesni::expand_key(input_key.data(), input_key.size(), key);
+        return;
+    }
+
+    std::copy(input_key.begin(), input_key.end(), key);
+
+    size_t nk = input_key.size() / 4;
+
+    for (size_t i = input_key.size(); i < BLOCK_SIZE * (rounds_ + 1);
+         i += 4) {
+        uint8_t temp_0 = key[i - 4];
+        uint8_t temp_1 = key[i - 3];
+        uint8_t temp_2 = key[i - 2];
+        uint8_t temp_3 = key[i - 1];
+
+        // SubWord through the bitsliced S-box: without AES-NI an S-box
+        // lookup would leak key bits through the cache
+        if (i % (nk * 4) == 0) {
+            const uint32_t word =
+                bitslice::sub_word(temp_1 | (temp_2 << 8) | (temp_3 << 16) |
+                                   (uint32_t(temp_0) << 24));
+            temp_0 = uint8_t(word) ^ round_constants[(i / 4) / nk];
+            temp_1 = word >> 8;
+            temp_2 = word >> 16;
+            temp_3 = word >> 24;
+        } else if (nk > 6 && ((i / 4) % nk == 4)) {
+            const uint32_t word =
+                bitslice::sub_word(temp_0 | (temp_1 << 8) | (temp_2 << 16) |
+                                   (uint32_t(temp_3) << 24));
+            temp_0 = word;
+            temp_1 = word >> 8;
+            temp_2 = word >> 16;
+            temp_3 = word >> 24;
+        }
+
+        key[i] = key[i - input_key.size()] ^ temp_0;
+        key[i + 1] = key[i - input_key.size() + 1] ^ temp_1;
+        key[i + 2] = key[i - input_key.size() + 2] ^ temp_2;
+        key[i + 3] = key[i - input_key.size() + 3] ^ temp_3;
+    }
+}
+
+const uint8_t* RoundKeys::decryption() const noexcept {
+    std::call_once(dec_once_, [this] {
+        dec_[0] = enc_[rounds_];
+        for (std::size_t round = 1; round < rounds_; ++round) {
+            dec_[round] = inv_mix_columns(enc_[rounds_ - round]);
+        }
+        dec_[rounds_] = enc_[0];
+    });
+    return dec_[0].data();
+}
+
+const uint64_t* RoundKeys::bitsliced() const noexcept {
+    std::call_once(sliced_once_, [this] {
+        bitslice::slice_key(enc_[0].data(), rounds_, sliced_.data());
+    });
+    return sliced_.data();
+}
+
+}  // namespace crypto
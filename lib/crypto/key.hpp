@@ -1,10 +1,14 @@
 #pragma once
 
-#include <crypto/tables.hpp>
+#include <array>
+#include <crypto/bitslice.hpp>
+#include <crypto/crypto.hpp>
 #include <cstdint>
 #include <errors/errors.hpp>
 #include <format>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace crypto {
@@ -32,6 +36,65 @@ class KeyError : public std::exception {
         KeyError& operator=(KeyError&&) = delete;
 };
 
+// Expanded key schedule, built once per key and never modified afterwards.
+// Fixed size and 64-byte aligned, so every round key is one aligned load
+// and no cipher call touches the heap.
+//
+// The decryption schedule is the one of the FIPS-197 equivalent inverse
+// cipher: the round keys in reverse order, with InvMixColumns applied to all
+// but the first and the last. It is only built the first time it is asked
+// for, so encrypt-only modes such as GCM never pay for it. The same goes for
+// the bitsliced copy of the encryption schedule, which only the constant-time
+// engine reads.
+class alignas(64) RoundKeys {
+    public:
+        static constexpr std::size_t MAX_ROUNDS = 14;
+        using Schedule = std::array<Block, MAX_ROUNDS + 1>;
+
+        // throws `KeyError` unless `input_key` is 16, 24 or 32 bytes
+        explicit RoundKeys(const std::vector<uint8_t>& input_key);
+        ~RoundKeys() = default;
+
+        std::size_t rounds() const noexcept { return rounds_; }
+
+        // `rounds() + 1` round keys, 16 bytes each
+        const uint8_t* encryption() const noexcept { return enc_[0].data(); }
+        const uint8_t* decryption() const noexcept;
+
+        // `(rounds() + 1) * bitslice::ROUND_KEY_WORDS` words
+        const uint64_t* bitsliced() const noexcept;
+
+        RoundKeys() = delete;
+        RoundKeys(RoundKeys&) = delete;
+        RoundKeys(RoundKeys&&) = delete;
+        RoundKeys& operator=(RoundKeys&) = delete;
+        RoundKeys& operator=(RoundKeys&&) = delete;
+
+    private:
+        Schedule enc_{};
+        alignas(64) mutable Schedule dec_{};
+        mutable std::once_flag dec_once_{};
+        alignas(64) mutable std::array<
+            uint64_t, bitslice::ROUND_KEY_WORDS * (MAX_ROUNDS + 1)> sliced_{};
+        mutable std::once_flag sliced_once_{};
+        std::size_t rounds_;
+};
+
+// Calls `fn` with `rounds` as a
+// `std::integral_constant<std::size_t, 10/12/14>`, so cipher kernels are
+// instantiated once per key size with their round loop fully unrolled.
+template <class Fn>
+decltype(auto) with_rounds(std::size_t rounds, Fn&& fn) {
+    switch (rounds) {
+        case 10:
+            return fn(std::integral_constant<std::size_t, 10>{});
+        case 12:
+            return fn(std::integral_constant<std::size_t, 12>{});
+        default:
+            return fn(std::integral_constant<std::size_t, 14>{});
+    }
+}
+
 class AesKey {
     public:
         enum class KeySize {
@@ -40,64 +103,25 @@ class AesKey {
             k_256 = 256,
         };
 
-        AesKey(const std::vector<uint8_t>& input_key) {
-            switch (input_key.size()) {
-                case 16:
-                    this->key = input_key;
-                    this->rounds = 10;
-                    key_size = KeySize::k_128;
-                    break;
-                case 24:
-                    this->key = input_key;
-                    this->rounds = 12;
-                    key_size = KeySize::k_192;
-                    break;
-                case 32:
-                    this->key = input_key;
-                    this->rounds = 14;
-                    key_size = KeySize::k_256;
-                    break;
-                default:
-                    throw KeyError(std::format("invalid key. length: {} bytes",
-                                               input_key.size()));
-            }
-
-            size_t nk = input_key.size() / 4;
-
-            for (int i = input_key.size(); i < 16 * (rounds + 1); i += 4) {
-                uint8_t temp_0 = key[i - 4];
-                uint8_t temp_1 = key[i - 3];
-                uint8_t temp_2 = key[i - 2];
-                uint8_t temp_3 = key[i - 1];
-
-                if (i % (nk * 4) == 0) {
-                    uint8_t temp_4 = temp_0;
-                    temp_0 = sub_byte(temp_1) ^ round_constants[(i / 4) / nk];
-                    temp_1 = sub_byte(temp_2);
-                    temp_2 = sub_byte(temp_3);
-                    temp_3 = sub_byte(temp_4);
-                } else if (nk > 6 && ((i / 4) % nk == 4)) {
-                    temp_0 = sub_byte(temp_0);
-                    temp_1 = sub_byte(temp_1);
-                    temp_2 = sub_byte(temp_2);
-                    temp_3 = sub_byte(temp_3);
-                }
-
-                key.push_back(key[i - input_key.size()] ^ temp_0);
-                key.push_back(key[i - input_key.size() + 1] ^ temp_1);
-                key.push_back(key[i - input_key.size() + 2] ^ temp_2);
-                key.push_back(key[i - input_key.size() + 3] ^ temp_3);
-            }
+        AesKey(const std::vector<uint8_t>& input_key)
+            : round_keys_{input_key},
+              key_size{static_cast<KeySize>(input_key.size() * 8)} {}
+
+        const size_t get_rounds() const { return round_keys_.rounds(); }
+        const KeySize get_key_size() const { return key_size; }
+
+        // copy of the expanded encryption key, cipher code should use
+        // `round_keys()` instead
+        const std::vector<uint8_t> get_key() const {
+            const uint8_t* key = round_keys_.encryption();
+            return {key, key + BLOCK_SIZE * (get_rounds() + 1)};
         }
 
-        const size_t get_rounds() { return rounds; }
-        const std::vector<uint8_t> get_key() { return key; }
-        const KeySize get_key_size() { return key_size; }
+        const RoundKeys& round_keys() const noexcept { return round_keys_; }
 
     private:
+        RoundKeys round_keys_;
         KeySize key_size;
-        uint8_t rounds;
-        std::vector<uint8_t> key;
 };
 
 }  // namespace crypto
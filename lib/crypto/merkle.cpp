@@ -0,0 +1,556 @@
+#include <algorithm>
+#include <crypto/merkle.hpp>
+#include <format>
+#include <io/io.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace crypto::ciphermode {
+
+namespace {
+
+constexpr std::size_t HEADER_SIZE = gcm_utils::IV_SIZE + 8;
+
+// `n` and the root
+constexpr std::size_t FOOTER_SIZE = 8 + BLOCK_SIZE;
+
+// one tag is the shortest chunk, an empty one is still a padding block
+constexpr uint64_t MIN_RECORD = 2 * BLOCK_SIZE;
+
+// the last chunk with PKCS#7 padding, a whole block of it when the chunk
+// ends on a block boundary
+void pad_last(std::string& chunk) {
+    const std::size_t pad = BLOCK_SIZE - chunk.size() % BLOCK_SIZE;
+    chunk.append(pad, char(pad));
+}
+
+// the padding off the last chunk, false when it is not valid
+bool unpad_last(std::string& chunk) noexcept {
+    if (chunk.empty()) {
+        return false;
+    }
+    const std::size_t pad = uint8_t(chunk.back());
+    if (pad == 0 || pad > BLOCK_SIZE || pad > chunk.size()) {
+        return false;
+    }
+    for (std::size_t i = chunk.size() - pad; i < chunk.size(); ++i) {
+        if (uint8_t(chunk[i]) != pad) {
+            return false;
+        }
+    }
+    chunk.resize(chunk.size() - pad);
+    return true;
+}
+
+void store_u64(uint64_t value, uint8_t* bytes) noexcept {
+    for (std::size_t i = 8; i-- > 0;) {
+        bytes[i] = uint8_t(value);
+        value >>= 8;
+    }
+}
+
+uint64_t load_u64(const uint8_t* bytes) noexcept {
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+// `iv` with `index` XORed into its last 8 bytes
+Block chunk_nonce(const Block& iv, uint64_t index) noexcept {
+    Block nonce{};
+    std::copy_n(iv.begin(), gcm_utils::IV_SIZE, nonce.begin());
+
+    uint8_t bytes[8]{};
+    store_u64(index, bytes);
+    for (std::size_t i = 0; i < 8; ++i) {
+        nonce[gcm_utils::IV_SIZE - 8 + i] ^= bytes[i];
+    }
+    return nonce;
+}
+
+// nonces of chunks leave the first byte of `iv` alone, those of nodes flip
+// its top bit and that of the root the next one
+Block node_nonce(const Block& iv, std::size_t level, uint64_t index) noexcept {
+    Block nonce = chunk_nonce(iv, index);
+    nonce[0] ^= 0x80;
+    nonce[1] ^= uint8_t(level);
+    return nonce;
+}
+
+Block root_nonce(const Block& iv) noexcept {
+    Block nonce = chunk_nonce(iv, 0);
+    nonce[0] ^= 0x40;
+    return nonce;
+}
+
+Block gmac(const CipherMode::AES& key, Block nonce,
+           std::span<const uint8_t> data) {
+    std::istringstream none{};
+    std::ostream null_output{nullptr};
+    GCM gcm{key, none, null_output, nonce};
+    gcm.add_aad(data);
+
+    const std::vector<char> t = gcm.tag();
+    Block tag{};
+    std::copy(t.begin(), t.end(), tag.begin());
+    return tag;
+}
+
+// node `index` of `level`, over its one or two `children`
+Block node(const CipherMode::AES& key, const Block& iv, std::size_t level,
+           uint64_t index, const Block* children, std::size_t count) {
+    uint8_t data[2 * BLOCK_SIZE]{};
+    for (std::size_t i = 0; i < count; ++i) {
+        std::copy(children[i].begin(), children[i].end(),
+                  data + i * BLOCK_SIZE);
+    }
+    return gmac(key, node_nonce(iv, level, index),
+                {data, count * BLOCK_SIZE});
+}
+
+Block root(const CipherMode::AES& key, const Block& iv, uint64_t chunks,
+           uint64_t chunk_size, const Block& top) {
+    uint8_t data[16 + BLOCK_SIZE]{};
+    store_u64(chunks, data);
+    store_u64(chunk_size, data + 8);
+    std::copy(top.begin(), top.end(), data + 16);
+    return gmac(key, root_nonce(iv), data);
+}
+
+// nodes per level, from the `leaves` up to the single top node
+std::vector<uint64_t> level_sizes(uint64_t leaves) {
+    std::vector<uint64_t> sizes{leaves};
+    while (sizes.back() > 1) {
+        sizes.push_back((sizes.back() + 1) / 2);
+    }
+    return sizes;
+}
+
+// the tree over `leaves`, `tree[0]` is `leaves` itself
+std::vector<std::vector<Block>> build_tree(const CipherMode::AES& key,
+                                           const Block& iv,
+                                           std::vector<Block> leaves) {
+    std::vector<std::vector<Block>> tree{std::move(leaves)};
+    while (tree.back().size() > 1) {
+        const std::vector<Block>& below = tree.back();
+        std::vector<Block> level((below.size() + 1) / 2);
+        for (uint64_t i = 0; i < level.size(); ++i) {
+            const std::size_t count =
+                std::min<uint64_t>(2, below.size() - 2 * i);
+            level[i] = node(key, iv, tree.size(), i, &below[2 * i], count);
+        }
+        tree.push_back(std::move(level));
+    }
+    return tree;
+}
+
+// `f(i)` for every `i < n`, on up to `threads` threads
+template <class F>
+void parallel_for(std::size_t n, std::size_t threads, F f) {
+    threads = std::min(n, threads);
+    if (threads <= 1) {
+        for (std::size_t i = 0; i < n; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    std::vector<std::jthread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (std::size_t i = t; i < n; i += threads) {
+                f(i);
+            }
+        });
+    }
+}
+
+[[noreturn]] void malformed() {
+    throw io::IOError{"not a Merkle container, or it is truncated",
+                      errors::Error::Other};
+}
+
+void read_exact(std::istream& in, uint64_t pos, void* bytes, std::size_t n) {
+    in.seekg(pos);
+    in.read(static_cast<char*>(bytes), n);
+    if (in.gcount() != std::streamsize(n)) {
+        malformed();
+    }
+}
+
+// where everything is in a container, from its header and footer
+struct Layout {
+        Block iv{};
+        uint64_t chunk_size{0};
+        uint64_t chunks{0};
+
+        // bytes of the last chunk and its tag
+        uint64_t last_record{0};
+
+        // the stored tree, `tree[0]` (the tags) left empty
+        std::vector<std::vector<Block>> tree{};
+        Block root{};
+
+        uint64_t record_offset(uint64_t index) const noexcept {
+            return HEADER_SIZE + index * (chunk_size + BLOCK_SIZE);
+        }
+
+        uint64_t record_size(uint64_t index) const noexcept {
+            return index + 1 == chunks ? last_record : chunk_size + BLOCK_SIZE;
+        }
+
+        static Layout read(std::istream& in) {
+            in.clear();
+            in.seekg(0, std::ios::end);
+            const std::streamoff end = in.tellg();
+            if (end < 0) {
+                throw io::IOError{"a Merkle container must be a seekable file",
+                                  errors::Error::Other};
+            }
+            const uint64_t size = end;
+            if (size < HEADER_SIZE + MIN_RECORD + FOOTER_SIZE) {
+                malformed();
+            }
+
+            Layout layout{};
+            uint8_t header[HEADER_SIZE]{};
+            read_exact(in, 0, header, HEADER_SIZE);
+            std::copy_n(header, gcm_utils::IV_SIZE, layout.iv.begin());
+            layout.chunk_size = load_u64(header + gcm_utils::IV_SIZE);
+
+            uint8_t footer[FOOTER_SIZE]{};
+            read_exact(in, size - FOOTER_SIZE, footer, FOOTER_SIZE);
+            layout.chunks = load_u64(footer);
+            std::copy_n(footer + 8, BLOCK_SIZE, layout.root.begin());
+
+            const uint64_t body = size - HEADER_SIZE - FOOTER_SIZE;
+            if (layout.chunk_size == 0 || layout.chunk_size % BLOCK_SIZE != 0 ||
+                layout.chunks == 0 || layout.chunks > body / MIN_RECORD) {
+                malformed();
+            }
+
+            const std::vector<uint64_t> sizes = level_sizes(layout.chunks);
+            uint64_t nodes = 0;
+            for (std::size_t level = 1; level < sizes.size(); ++level) {
+                nodes += sizes[level];
+            }
+
+            // all of it below `size`, so no overflow past the checks above
+            const uint128_t full_records =
+                uint128_t(layout.chunks - 1) *
+                (layout.chunk_size + BLOCK_SIZE);
+            const uint128_t fixed = full_records + nodes * BLOCK_SIZE;
+            if (fixed + MIN_RECORD > body) {
+                malformed();
+            }
+            layout.last_record = uint64_t(body - fixed);
+            if (layout.last_record % BLOCK_SIZE != 0 ||
+                layout.last_record > layout.chunk_size + 2 * BLOCK_SIZE) {
+                malformed();
+            }
+
+            uint64_t pos = HEADER_SIZE + uint64_t(full_records) +
+                           layout.last_record;
+            layout.tree.resize(sizes.size());
+            for (std::size_t level = 1; level < sizes.size(); ++level) {
+                std::vector<Block>& stored = layout.tree[level];
+                stored.resize(sizes[level]);
+                read_exact(in, pos, stored.data(), sizes[level] * BLOCK_SIZE);
+                pos += sizes[level] * BLOCK_SIZE;
+            }
+            return layout;
+        }
+
+        std::string read_record(std::istream& in, uint64_t index) const {
+            std::string record(record_size(index), '\0');
+            read_exact(in, record_offset(index), record.data(), record.size());
+            return record;
+        }
+
+        // the tag of chunk `index`
+        Block read_leaf(std::istream& in, uint64_t index) const {
+            Block leaf{};
+            read_exact(in,
+                       record_offset(index) + record_size(index) - BLOCK_SIZE,
+                       leaf.data(), BLOCK_SIZE);
+            return leaf;
+        }
+};
+
+Block record_tag(const std::string& record) noexcept {
+    Block tag{};
+    std::copy(record.end() - BLOCK_SIZE, record.end(), tag.begin());
+    return tag;
+}
+
+// Rebuild the tree over `leaves` and compare it with the stored one. Only
+// nodes above a chunk in `bad`, whose tag is already known to be wrong, may
+// differ; anything else is a forged tree.
+void check_tree(const CipherMode::AES& key, const Layout& layout,
+                std::vector<Block> leaves, const std::vector<bool>& bad) {
+    const std::vector<std::vector<Block>> tree =
+        build_tree(key, layout.iv, std::move(leaves));
+
+    std::vector<bool> tainted{bad};
+    for (std::size_t level = 1; level < tree.size(); ++level) {
+        std::vector<bool> above(tree[level].size());
+        for (uint64_t i = 0; i < above.size(); ++i) {
+            above[i] = tainted[2 * i] ||
+                       (2 * i + 1 < tainted.size() && tainted[2 * i + 1]);
+            if (!above[i] && tree[level][i] != layout.tree[level][i]) {
+                throw io::IOError{"Merkle tree does not match the chunk tags",
+                                  errors::Error::Other};
+            }
+        }
+        tainted = std::move(above);
+    }
+
+    const Block expected = root(key, layout.iv, layout.chunks,
+                                layout.chunk_size, tree.back().front());
+    if (!tainted.front() && expected != layout.root) {
+        throw io::IOError{"Merkle root does not match the tree",
+                          errors::Error::Other};
+    }
+}
+
+// Walk from the good chunk `index` up to the root, with the stored
+// siblings; the one next to the chunk is read from its record.
+void check_path(const CipherMode::AES& key, const Layout& layout,
+                std::istream& in, uint64_t index, Block hash) {
+    uint64_t position = index;
+    for (std::size_t level = 1; level < layout.tree.size(); ++level) {
+        const uint64_t sibling = position ^ 1;
+        const uint64_t below = level == 1 ? layout.chunks
+                                          : layout.tree[level - 1].size();
+
+        Block pair[2]{};
+        pair[position & 1] = hash;
+        if (sibling < below) {
+            pair[sibling & 1] = level == 1 ? layout.read_leaf(in, sibling)
+                                           : layout.tree[level - 1][sibling];
+        }
+
+        position /= 2;
+        hash = node(key, layout.iv, level, position, pair,
+                    sibling < below ? 2 : 1);
+        if (hash != layout.tree[level][position]) {
+            throw io::IOError{
+                std::format("Merkle path of chunk {} does not match", index),
+                errors::Error::Other};
+        }
+    }
+
+    if (root(key, layout.iv, layout.chunks, layout.chunk_size, hash) !=
+        layout.root) {
+        throw io::IOError{"Merkle root does not match the tree",
+                          errors::Error::Other};
+    }
+}
+
+}  // namespace
+
+MerkleGCM::MerkleGCM(const CipherMode::AES& key, std::size_t threads)
+    : key_{key}, threads_{std::max<std::size_t>(threads, 1)} {}
+
+void MerkleGCM::encrypt_fd(std::istream& in, std::ostream& out,
+                           const Block& iv, uint64_t chunk_size) {
+    uint8_t header[HEADER_SIZE]{};
+    std::copy_n(iv.begin(), gcm_utils::IV_SIZE, header);
+    store_u64(chunk_size, header + gcm_utils::IV_SIZE);
+    out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+
+    std::vector<Block> leaves{};
+    bool done = false;
+    while (!done) {
+        // read a chunk per thread, an empty input is still one chunk
+        std::vector<std::string> batch{};
+        while (batch.size() < threads_ && !done) {
+            std::string chunk(chunk_size, '\0');
+            in.read(chunk.data(), chunk_size);
+            chunk.resize(in.gcount());
+            done = chunk.size() < chunk_size ||
+                   in.peek() == std::istream::traits_type::eof();
+            batch.push_back(std::move(chunk));
+        }
+        if (done) {
+            pad_last(batch.back());
+        }
+
+        // whole blocks, GCM adds no padding of its own
+        const uint64_t first = leaves.size();
+        std::vector<std::string> records(batch.size());
+        parallel_for(batch.size(), threads_, [&](std::size_t i) {
+            Block nonce = chunk_nonce(iv, first + i);
+            std::istringstream chunk_in{batch[i]};
+            std::ostringstream chunk_out{};
+            GCM gcm{key_, chunk_in, chunk_out, nonce};
+            gcm.set_padded(false);
+            gcm.encrypt_fd();
+            records[i] = chunk_out.str();
+        });
+
+        for (const std::string& record : records) {
+            out.write(record.data(), record.size());
+            leaves.push_back(record_tag(record));
+        }
+    }
+
+    const uint64_t chunks = leaves.size();
+    const std::vector<std::vector<Block>> tree =
+        build_tree(key_, iv, std::move(leaves));
+    for (std::size_t level = 1; level < tree.size(); ++level) {
+        for (const Block& node : tree[level]) {
+            out.write(reinterpret_cast<const char*>(node.data()), BLOCK_SIZE);
+        }
+    }
+
+    uint8_t footer[FOOTER_SIZE]{};
+    store_u64(chunks, footer);
+    const Block top = root(key_, iv, chunks, chunk_size, tree.back().front());
+    std::copy(top.begin(), top.end(), footer + 8);
+    out.write(reinterpret_cast<const char*>(footer), FOOTER_SIZE);
+}
+
+void MerkleGCM::decrypt_fd(std::istream& in, std::ostream& out) {
+    const Layout layout = Layout::read(in);
+
+    std::vector<Block> leaves(layout.chunks);
+    for (uint64_t i = 0; i < layout.chunks; ++i) {
+        leaves[i] = layout.read_leaf(in, i);
+    }
+    check_tree(key_, layout, std::move(leaves),
+               std::vector<bool>(layout.chunks));
+
+    for (uint64_t first = 0; first < layout.chunks; first += threads_) {
+        const std::size_t n =
+            std::min<uint64_t>(threads_, layout.chunks - first);
+
+        std::vector<std::string> records(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            records[i] = layout.read_record(in, first + i);
+        }
+
+        // no plaintext of a batch is written before all of it checked out
+        std::vector<std::string> plaintexts(n);
+        std::vector<char> bad(n);
+        parallel_for(n, threads_, [&](std::size_t i) {
+            Block nonce = chunk_nonce(layout.iv, first + i);
+            std::istringstream chunk_in{records[i]};
+            std::ostringstream chunk_out{};
+            try {
+                GCM gcm{key_, chunk_in, chunk_out, nonce};
+                gcm.set_padded(false);
+                gcm.decrypt_fd();
+                plaintexts[i] = chunk_out.str();
+            } catch (const io::IOError&) {
+                bad[i] = true;
+            }
+        });
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (bad[i]) {
+                throw io::IOError{
+                    std::format("data integrity violated in chunk {}",
+                                first + i),
+                    errors::Error::Other};
+            }
+        }
+        if (first + n == layout.chunks && !unpad_last(plaintexts.back())) {
+            malformed();
+        }
+        for (const std::string& plaintext : plaintexts) {
+            out.write(plaintext.data(), plaintext.size());
+        }
+    }
+}
+
+std::vector<uint64_t> MerkleGCM::verify_fd(std::istream& in) {
+    const Layout layout = Layout::read(in);
+
+    std::vector<Block> leaves(layout.chunks);
+    std::vector<bool> bad(layout.chunks);
+    for (uint64_t first = 0; first < layout.chunks; first += threads_) {
+        const std::size_t n =
+            std::min<uint64_t>(threads_, layout.chunks - first);
+
+        std::vector<std::string> records(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            records[i] = layout.read_record(in, first + i);
+            leaves[first + i] = record_tag(records[i]);
+        }
+
+        std::vector<char> failed(n);
+        parallel_for(n, threads_, [&](std::size_t i) {
+            Block nonce = chunk_nonce(layout.iv, first + i);
+            std::istringstream chunk_in{records[i]};
+            std::ostringstream chunk_out{};
+            try {
+                GCM{key_, chunk_in, chunk_out, nonce}.verify_fd();
+            } catch (const io::IOError&) {
+                failed[i] = true;
+            }
+        });
+        for (std::size_t i = 0; i < n; ++i) {
+            bad[first + i] = failed[i];
+        }
+    }
+
+    check_tree(key_, layout, std::move(leaves), bad);
+
+    std::vector<uint64_t> result{};
+    for (uint64_t i = 0; i < layout.chunks; ++i) {
+        if (bad[i]) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+std::vector<uint64_t> MerkleGCM::verify_chunks(
+    std::istream& in, const std::vector<uint64_t>& indices) {
+    const Layout layout = Layout::read(in);
+    for (const uint64_t index : indices) {
+        if (index >= layout.chunks) {
+            throw io::IOError{std::format("no chunk {}, the container has {}",
+                                          index, layout.chunks),
+                              errors::Error::InvalidArgument};
+        }
+    }
+
+    std::vector<uint64_t> result{};
+    for (std::size_t first = 0; first < indices.size(); first += threads_) {
+        const std::size_t n = std::min(threads_, indices.size() - first);
+
+        std::vector<std::string> records(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            records[i] = layout.read_record(in, indices[first + i]);
+        }
+
+        std::vector<char> failed(n);
+        parallel_for(n, threads_, [&](std::size_t i) {
+            Block nonce = chunk_nonce(layout.iv, indices[first + i]);
+            std::istringstream chunk_in{records[i]};
+            std::ostringstream chunk_out{};
+            try {
+                GCM{key_, chunk_in, chunk_out, nonce}.verify_fd();
+            } catch (const io::IOError&) {
+                failed[i] = true;
+            }
+        });
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (failed[i]) {
+                result.push_back(indices[first + i]);
+            } else {
+                check_path(key_, layout, in, indices[first + i],
+                           record_tag(records[i]));
+            }
+        }
+    }
+    return result;
+}
+
+}  // namespace crypto::ciphermode
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <crypto/ciphermode.hpp>
+#include <crypto/crypto.hpp>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Merkle container: the message is cut into chunks of `chunk_size` bytes,
+// each encrypted as its own GCM message, and a Merkle tree over the chunk
+// tags ends the file. Chunks can be checked in parallel, one at a time or
+// any subset of them, and a bad chunk is named without decrypting the rest.
+//
+//     iv (12) | chunk_size (8)
+//     chunk 0 ciphertext | tag 0
+//     ...
+//     chunk n-1 ciphertext | tag n-1
+//     tree nodes above the tags, level by level from the bottom (16 each)
+//     n (8) | root (16)
+//
+// Integers are big-endian. Chunk `i` is a GCM message under the nonce `iv`
+// with `i` XORed into its last 8 bytes. Only the last chunk is padded,
+// PKCS#7 with 1 to 16 bytes, so every chunk but the last is exactly
+// `chunk_size + 16` bytes and none loses trailing bytes that merely look
+// like padding. The tags are the leaves; a node is the GMAC of its one or
+// two children under a nonce naming its level and position, and the root
+// is the GMAC of `n`, `chunk_size` and the top node, which authenticates
+// the shape of the tree as well.
+namespace crypto::ciphermode {
+
+class MerkleGCM {
+    public:
+        static constexpr uint64_t DEFAULT_CHUNK_SIZE = uint64_t(1) << 20;
+
+        // `threads` chunks are processed at a time
+        MerkleGCM(const CipherMode::AES& key, std::size_t threads = 1);
+
+        // `chunk_size` is a positive multiple of 16; only the first 12
+        // bytes of `iv` are used
+        void encrypt_fd(std::istream& in, std::ostream& out, const Block& iv,
+                        uint64_t chunk_size);
+
+        // Checks the tree, then writes each chunk once its tag matched.
+        // Throws `io::IOError` naming the first bad chunk. `in` must be
+        // seekable, as for all of the reading side.
+        void decrypt_fd(std::istream& in, std::ostream& out);
+
+        // The chunks whose tag does not match, in order; empty when the
+        // whole container is intact. Throws `io::IOError` when the tree
+        // itself was tampered with, apart from the leaves of bad chunks.
+        std::vector<uint64_t> verify_fd(std::istream& in);
+
+        // Only the chunks at `indices`, without reading the others: those
+        // of them whose tag does not match. Throws `io::IOError` unless the
+        // path of each good one through the tree reaches the root.
+        std::vector<uint64_t> verify_chunks(
+            std::istream& in, const std::vector<uint64_t>& indices);
+
+    private:
+        const CipherMode::AES& key_;
+        const std::size_t threads_;
+};
+
+}  // namespace crypto::ciphermode
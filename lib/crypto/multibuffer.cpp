@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <crypto/aes.hpp>
+#include <crypto/aesgcm.hpp>
+#include <crypto/ciphermode.hpp>
+#include <crypto/multibuffer.hpp>
+#include <cstring>
+
+namespace crypto::multibuffer {
+
+namespace {
+
+namespace gcm_utils = ciphermode::gcm_utils;
+using ciphermode::uint128_t;
+
+// messages in flight
+constexpr std::size_t LANES = 8;
+
+// blocks of each message per step, one GHASH reduction with PCLMULQDQ
+constexpr std::size_t STEP_BLOCKS = ghash::Clmul::POWERS;
+
+// one message of a group, from its first counter block to its tag
+struct Lane {
+        const GcmMessage* message{nullptr};
+        std::optional<gcm_utils::AuthTag> tag{};
+        Block counter{};
+        std::vector<Block> blocks{};
+
+        // `blocks` already through counter mode and GHASH
+        std::size_t done{0};
+};
+
+// zero-padded, like `GCM::add_aad`
+void hash_aad(gcm_utils::AuthTag& tag, std::span<const uint8_t> aad) {
+    std::array<Block, 16> batch{};
+    while (aad.size() >= BLOCK_SIZE) {
+        const std::size_t n = std::min(batch.size(), aad.size() / BLOCK_SIZE);
+        std::memcpy(batch.data(), aad.data(), n * BLOCK_SIZE);
+        tag.update_tag({batch.data(), n});
+        aad = aad.subspan(n * BLOCK_SIZE);
+    }
+    if (aad.size()) {
+        Block last{};
+        std::copy(aad.begin(), aad.end(), last.begin());
+        tag.update_tag(last);
+    }
+}
+
+// H and the tag mask of every lane in one batch: the counter blocks 0 and
+// 1 of each IV, as in the `GCM` constructor
+void start(std::span<Lane> lanes) {
+    std::array<Block, 2 * LANES> blocks{};
+    std::array<const RoundKeys*, 2 * LANES> keys{};
+    for (std::size_t j = 0; j < lanes.size(); ++j) {
+        const GcmMessage& m = *lanes[j].message;
+        blocks[2 * j] = m.iv;
+        blocks[2 * j + 1] = m.iv;
+        gcm_utils::inc_counter(blocks[2 * j + 1]);
+        keys[2 * j] = keys[2 * j + 1] = &m.key->round_keys();
+    }
+
+    const std::size_t n = 2 * lanes.size();
+    encrypt_blocks(std::span{keys}.first(n), std::span{blocks}.first(n),
+                   std::span{blocks}.first(n));
+
+    for (std::size_t j = 0; j < lanes.size(); ++j) {
+        Lane& lane = lanes[j];
+        lane.tag.emplace(blocks[2 * j], blocks[2 * j + 1] ^ lane.message->iv);
+        hash_aad(*lane.tag, lane.message->aad);
+
+        // the payload starts with counter value 3
+        lane.counter = lane.message->iv;
+        gcm_utils::add_counter(lane.counter, 3);
+    }
+}
+
+// Counter mode and GHASH over the blocks of all `lanes`. With AES-NI and
+// PCLMULQDQ the whole steps of each lane go through the stitched loop,
+// which already keeps eight blocks in flight. The rest, and everything on
+// the other engines, goes `STEP_BLOCKS` blocks of each lane per step, the
+// keystream of a step in one multi-key batch; the last few blocks of each
+// message would otherwise be encrypted one at a time.
+template <bool Decrypt>
+void crypt(std::span<Lane> lanes) {
+    for (Lane& lane : lanes) {
+        lane.done = 0;
+        if (engine() != Engine::AesNi || !lane.tag->clmul()) {
+            continue;
+        }
+
+        const RoundKeys& rk = lane.message->key->round_keys();
+        const std::size_t bulk =
+            lane.blocks.size() / STEP_BLOCKS * STEP_BLOCKS;
+        if (bulk > 0) {
+            const auto stitched = Decrypt ? aesgcm::decrypt : aesgcm::encrypt;
+            stitched(rk.encryption(), rk.rounds(), *lane.tag->clmul(),
+                     lane.tag->state(), lane.counter, lane.blocks.data(),
+                     bulk);
+            lane.done = bulk;
+        }
+    }
+
+    std::array<Block, LANES * STEP_BLOCKS> keystream{};
+    std::array<const RoundKeys*, LANES * STEP_BLOCKS> keys{};
+    while (true) {
+        std::size_t n = 0;
+        for (Lane& lane : lanes) {
+            const std::size_t count =
+                std::min(STEP_BLOCKS, lane.blocks.size() - lane.done);
+            for (std::size_t i = 0; i < count; ++i) {
+                keystream[n] = lane.counter;
+                keys[n] = &lane.message->key->round_keys();
+                gcm_utils::inc_counter(lane.counter);
+                ++n;
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+        encrypt_blocks(std::span{keys}.first(n),
+                       std::span{keystream}.first(n),
+                       std::span{keystream}.first(n));
+
+        n = 0;
+        for (Lane& lane : lanes) {
+            const std::span<Block> blocks{
+                lane.blocks.data() + lane.done,
+                std::min(STEP_BLOCKS, lane.blocks.size() - lane.done)};
+            lane.done += blocks.size();
+
+            if constexpr (Decrypt) {
+                lane.tag->update_tag(blocks);
+            }
+            for (Block& block : blocks) {
+                block ^= keystream[n++];
+            }
+            if constexpr (!Decrypt) {
+                lane.tag->update_tag(blocks);
+            }
+        }
+    }
+}
+
+// like `GCM::tag`
+Block finish(Lane& lane) {
+    const uint128_t lengths =
+        (uint128_t(lane.message->aad.size()) << 64) |
+        uint128_t(lane.blocks.size() * BLOCK_SIZE);
+
+    Block len_block{};
+    gcm_utils::AuthTag::uint128_t_to_bytes(lengths, len_block);
+    lane.tag->update_tag(len_block);
+
+    Block tag{};
+    gcm_utils::AuthTag::uint128_t_to_bytes(
+        lane.tag->value() ^ lane.tag->counter0(), tag);
+    return tag;
+}
+
+// `LANES` messages at a time, `load` fills the blocks of a lane and
+// `store` takes them back with the tag
+template <bool Decrypt, class Load, class Store>
+void run(std::span<const GcmMessage> messages, Load load, Store store) {
+    std::array<Lane, LANES> group{};
+    for (std::size_t first = 0; first < messages.size(); first += LANES) {
+        const std::size_t n = std::min(LANES, messages.size() - first);
+        const std::span<Lane> lanes{group.data(), n};
+
+        for (std::size_t j = 0; j < n; ++j) {
+            lanes[j].message = &messages[first + j];
+            lanes[j].tag.reset();
+            load(*lanes[j].message, lanes[j].blocks);
+        }
+
+        start(lanes);
+        crypt<Decrypt>(lanes);
+
+        for (std::size_t j = 0; j < n; ++j) {
+            store(first + j, lanes[j].blocks, finish(lanes[j]));
+        }
+    }
+}
+
+// one CBC message in flight: its next block and the ciphertext block
+// before it
+struct Chain {
+        const CbcMessage* message{nullptr};
+        std::size_t block{0};
+        std::size_t blocks{0};
+        Block previous{};
+};
+
+// block `i` of the plaintext of `m`, the last one padded like
+// `CipherMode::encrypt_fd`
+Block cbc_block(const CbcMessage& m, std::size_t i) {
+    Block block{};
+    const std::size_t begin = i * BLOCK_SIZE;
+    const std::size_t n = std::min(BLOCK_SIZE, m.input.size() - begin);
+    if (n > 0) {
+        std::memcpy(block.data(), m.input.data() + begin, n);
+    }
+    if (n < BLOCK_SIZE) {
+        pad_pkcs7(block, n);
+    }
+    return block;
+}
+
+}  // namespace
+
+std::vector<Block> gcm_encrypt(std::span<const GcmMessage> messages) {
+    std::vector<Block> tags(messages.size());
+
+    const auto load = [](const GcmMessage& m, std::vector<Block>& blocks) {
+        blocks.assign(gcm_ciphertext_size(m.input.size()) / BLOCK_SIZE,
+                      Block{});
+        if (!m.input.empty()) {
+            std::memcpy(blocks.data(), m.input.data(), m.input.size());
+        }
+
+        const std::size_t remainder = m.input.size() % BLOCK_SIZE;
+        if (remainder != 0 || m.input.empty()) {
+            pad_pkcs7(blocks.back(), remainder);
+        }
+    };
+    const auto store = [&](std::size_t i, const std::vector<Block>& blocks,
+                           const Block& tag) {
+        std::memcpy(messages[i].output, blocks.data(),
+                    blocks.size() * BLOCK_SIZE);
+        tags[i] = tag;
+    };
+
+    run<false>(messages, load, store);
+    return tags;
+}
+
+std::vector<std::optional<std::size_t>> gcm_decrypt(
+    std::span<const GcmMessage> messages, std::span<const Block> tags) {
+    assert(tags.size() >= messages.size());
+    std::vector<std::optional<std::size_t>> lengths(messages.size());
+
+    // inputs that are not whole blocks go through as empty and fail below
+    const auto load = [](const GcmMessage& m, std::vector<Block>& blocks) {
+        const bool whole =
+            m.input.size() % BLOCK_SIZE == 0 && m.input.size() > 0;
+        blocks.resize(whole ? m.input.size() / BLOCK_SIZE : 0);
+        if (whole) {
+            std::memcpy(blocks.data(), m.input.data(), m.input.size());
+        }
+    };
+    const auto store = [&](std::size_t i, std::vector<Block>& blocks,
+                           const Block& tag) {
+        const GcmMessage& m = messages[i];
+
+        // no early exit, the comparison takes the same time for any tag
+        uint8_t diff = 0;
+        for (std::size_t b = 0; b < BLOCK_SIZE; ++b) {
+            diff |= tag[b] ^ tags[i][b];
+        }
+        if (diff != 0 || blocks.empty()) {
+            if (!m.input.empty()) {
+                std::memset(m.output, 0, m.input.size());
+            }
+            return;
+        }
+
+        const std::size_t last = rm_pad_pkcs7(blocks.back());
+        const std::size_t length = (blocks.size() - 1) * BLOCK_SIZE + last;
+        std::memcpy(m.output, blocks.data(), length);
+        lengths[i] = length;
+    };
+
+    run<true>(messages, load, store);
+    return lengths;
+}
+
+void cbc_encrypt(std::span<const CbcMessage> messages) {
+    std::array<Chain, LANES> chains{};
+    std::array<Block, LANES> blocks{};
+    std::array<const RoundKeys*, LANES> keys{};
+
+    // a chain that ends takes the next message, so each step has `LANES`
+    // blocks in flight until the messages run out, however their lengths
+    // differ
+    std::size_t next = 0;
+    const auto refill = [&](Chain& chain) {
+        chain.message = nullptr;
+        if (next < messages.size()) {
+            const CbcMessage& m = messages[next++];
+            chain = {&m, 0, cbc_ciphertext_size(m.input.size()) / BLOCK_SIZE,
+                     m.iv};
+        }
+    };
+    for (Chain& chain : chains) {
+        refill(chain);
+    }
+
+    while (true) {
+        std::size_t n = 0;
+        for (const Chain& chain : chains) {
+            if (chain.message) {
+                blocks[n] = cbc_block(*chain.message, chain.block) ^
+                            chain.previous;
+                keys[n] = &chain.message->key->round_keys();
+                ++n;
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+        encrypt_blocks(std::span{keys}.first(n), std::span{blocks}.first(n),
+                       std::span{blocks}.first(n));
+
+        n = 0;
+        for (Chain& chain : chains) {
+            if (chain.message) {
+                const Block& ciphertext = blocks[n++];
+                std::memcpy(chain.message->output + chain.block * BLOCK_SIZE,
+                            ciphertext.data(), BLOCK_SIZE);
+                chain.previous = ciphertext;
+                if (++chain.block == chain.blocks) {
+                    refill(chain);
+                }
+            }
+        }
+    }
+}
+
+}  // namespace crypto::multibuffer
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <crypto/crypto.hpp>
+#include <crypto/key.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Multi-buffer modes: many short independent messages, each with its own key
+// and IV, processed side by side. One stream of a few hundred bytes cannot
+// keep the AES pipeline busy, and setting up a `GCM` stream per message
+// costs more than the message itself. Here the counter blocks of a group of
+// messages go through one multi-key batch call, and their GHASH chains are
+// independent, so they overlap as well. CBC encryption cannot be batched
+// within a message at all, every block waits for the one before it, but
+// the chains of different messages run in lockstep the same way.
+namespace crypto::multibuffer {
+
+// GCM ciphertext bytes for `n` bytes of plaintext, before the tag: like
+// `GCM::encrypt_fd`, a partial or empty last block is padded
+constexpr std::size_t gcm_ciphertext_size(std::size_t n) noexcept {
+    return n % BLOCK_SIZE != 0 || n == 0 ? (n / BLOCK_SIZE + 1) * BLOCK_SIZE
+                                         : n;
+}
+
+struct GcmMessage {
+        const AesKey* key;
+
+        // as the `iv` of `GCM`
+        Block iv;
+
+        // may be empty
+        std::span<const uint8_t> aad;
+
+        std::span<const uint8_t> input;
+
+        // `gcm_ciphertext_size(input.size())` bytes to encrypt,
+        // `input.size()` to decrypt
+        uint8_t* output;
+};
+
+// Encrypts every message the way `GCM` with `add_aad(aad)` and `encrypt_fd`
+// does; returns the tags, in order, the ciphertexts go to `output`.
+std::vector<Block> gcm_encrypt(std::span<const GcmMessage> messages);
+
+// Decrypts every message against its tag in `tags`. Returns the plaintext
+// length of each message, or nothing when its tag does not match or its
+// input is not whole blocks; its `output` is then zeroed.
+std::vector<std::optional<std::size_t>> gcm_decrypt(
+    std::span<const GcmMessage> messages, std::span<const Block> tags);
+
+struct CbcMessage {
+        const AesKey* key;
+
+        // as the `iv` of `CBC`
+        Block iv;
+
+        std::span<const uint8_t> input;
+
+        // `cbc_ciphertext_size(input.size())` bytes
+        uint8_t* output;
+};
+
+// CBC ciphertext bytes for `n` bytes of plaintext, padded as in GCM
+constexpr std::size_t cbc_ciphertext_size(std::size_t n) noexcept {
+    return gcm_ciphertext_size(n);
+}
+
+// Encrypts every message the way `CBC` with `encrypt_fd` does, the
+// ciphertexts go to `output`. Decryption batches within a message already,
+// see `CBC::decrypt_chunk`.
+void cbc_encrypt(std::span<const CbcMessage> messages);
+
+}  // namespace crypto::multibuffer
@@ -0,0 +1,54 @@
+#include <crypto/ghash.hpp>
+#include <crypto/pclmul.hpp>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+namespace crypto::ghash {
+
+namespace {
+
+PCLMUL_TARGET void init(const Element& h, Block* powers,
+                        Block* karatsuba) noexcept {
+    const __m128i h1 = pclmul::load_element(h);
+    __m128i power = h1;
+    for (std::size_t i = 0; i < Clmul::POWERS; ++i) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(powers[i].data()), power);
+        _mm_store_si128(reinterpret_cast<__m128i*>(karatsuba[i].data()),
+                        pclmul::fold_halves(power));
+        power = pclmul::multiply(power, h1);
+    }
+}
+
+PCLMUL_TARGET void update(Element& state, const pclmul::Powers& h,
+                          const Block* blocks, std::size_t n) noexcept {
+    state = pclmul::store_element(
+        pclmul::update(pclmul::load_element(state), h, blocks, n));
+}
+
+}  // namespace
+
+Clmul::Clmul(const Element& h) noexcept {
+    init(h, powers_.data(), karatsuba_.data());
+}
+
+void Clmul::update(Element& state, const Block* blocks,
+                   std::size_t n) const noexcept {
+    ghash::update(state, {powers(), karatsuba()}, blocks, n);
+}
+
+}  // namespace crypto::ghash
+
+#else
+
+namespace crypto::ghash {
+
+Clmul::Clmul(const Element&) noexcept { std::abort(); }
+
+void Clmul::update(Element&, const Block*, std::size_t) const noexcept {
+    std::abort();
+}
+
+}  // namespace crypto::ghash
+
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <crypto/ghash.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define PCLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+
+// PCLMULQDQ building blocks of `ghash::Clmul`, shared with the stitched
+// AES-GCM loop. Only include this from translation units that check
+// `cpu::has_pclmul()` before calling in.
+//
+// The multiplication and the reduction follow Intel's "Carry-Less Multiply
+// Instruction and its Usage for Computing the GCM Mode" (Gueron, Kounavis).
+// Blocks are byte reversed on load, which turns the GCM bit order into a
+// polynomial reflected within one 128-bit register: the product of two of
+// them is the reflected product shifted right by one bit, fixed by the
+// shift in `reduce`.
+namespace crypto::ghash::pclmul {
+
+// the 256-bit carry-less product, Karatsuba terms not yet combined
+struct Product {
+        __m128i lo;
+        __m128i mid;
+        __m128i hi;
+};
+
+PCLMUL_TARGET inline Product zero_product() noexcept {
+    return {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+}
+
+// reverses the 16 bytes of a register
+PCLMUL_TARGET inline __m128i reverse_mask() noexcept {
+    return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+PCLMUL_TARGET inline __m128i load_reflected(const Block& block) noexcept {
+    return _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block.data())),
+        reverse_mask());
+}
+
+PCLMUL_TARGET inline __m128i load_element(const Element& e) noexcept {
+    return _mm_set_epi64x(e.hi, e.lo);
+}
+
+PCLMUL_TARGET inline Element store_element(__m128i x) noexcept {
+    alignas(16) uint64_t halves[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(halves), x);
+    return {halves[1], halves[0]};
+}
+
+// high and low half of `x` XORed together, in the low half
+PCLMUL_TARGET inline __m128i fold_halves(__m128i x) noexcept {
+    return _mm_xor_si128(x, _mm_shuffle_epi32(x, 0x4e));
+}
+
+// p += x * h, `h_k` is `fold_halves(h)`
+PCLMUL_TARGET inline void multiply_add(Product& p, __m128i x, __m128i h,
+                                       __m128i h_k) noexcept {
+    p.lo = _mm_xor_si128(p.lo, _mm_clmulepi64_si128(x, h, 0x00));
+    p.hi = _mm_xor_si128(p.hi, _mm_clmulepi64_si128(x, h, 0x11));
+    p.mid = _mm_xor_si128(p.mid,
+                          _mm_clmulepi64_si128(fold_halves(x), h_k, 0x00));
+}
+
+// combine the Karatsuba terms, shift the 256-bit product left by one and
+// reduce it modulo x^128 + x^7 + x^2 + x + 1
+PCLMUL_TARGET inline __m128i reduce(const Product& p) noexcept {
+    const __m128i mid = _mm_xor_si128(p.mid, _mm_xor_si128(p.lo, p.hi));
+    __m128i lo = _mm_xor_si128(p.lo, _mm_slli_si128(mid, 8));
+    __m128i hi = _mm_xor_si128(p.hi, _mm_srli_si128(mid, 8));
+
+    // hi:lo <<= 1
+    __m128i carry_lo = _mm_srli_epi32(lo, 31);
+    __m128i carry_hi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    const __m128i carry_mid = _mm_srli_si128(carry_lo, 12);
+    carry_hi = _mm_slli_si128(carry_hi, 4);
+    carry_lo = _mm_slli_si128(carry_lo, 4);
+    lo = _mm_or_si128(lo, carry_lo);
+    hi = _mm_or_si128(_mm_or_si128(hi, carry_hi), carry_mid);
+
+    // first phase of the reduction
+    __m128i t = _mm_xor_si128(
+        _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+        _mm_slli_epi32(lo, 25));
+    const __m128i t_hi = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+
+    // second phase
+    t = _mm_xor_si128(
+        _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+        _mm_srli_epi32(lo, 7));
+    t = _mm_xor_si128(t, t_hi);
+    return _mm_xor_si128(hi, _mm_xor_si128(lo, t));
+}
+
+PCLMUL_TARGET inline __m128i multiply(__m128i x, __m128i h) noexcept {
+    Product p = zero_product();
+    multiply_add(p, x, h, fold_halves(h));
+    return reduce(p);
+}
+
+// `Clmul::powers()` and `Clmul::karatsuba()`, as registers
+struct Powers {
+        const Block* powers;
+        const Block* karatsuba;
+
+        // H^(i + 1)
+        PCLMUL_TARGET __m128i power(std::size_t i) const noexcept {
+            return _mm_load_si128(
+                reinterpret_cast<const __m128i*>(&powers[i]));
+        }
+
+        PCLMUL_TARGET __m128i power_k(std::size_t i) const noexcept {
+            return _mm_load_si128(
+                reinterpret_cast<const __m128i*>(&karatsuba[i]));
+        }
+};
+
+// y = (...((y ^ blocks[0]) * H ^ blocks[1]) * H ...) * H, `Clmul::POWERS`
+// blocks per reduction: y = (y ^ x0) H^k ^ x1 H^(k-1) ^ ... ^ x(k-1) H
+PCLMUL_TARGET inline __m128i update(__m128i y, const Powers& h,
+                                    const Block* blocks,
+                                    std::size_t n) noexcept {
+    while (n > 0) {
+        const std::size_t k = n < Clmul::POWERS ? n : Clmul::POWERS;
+
+        Product p = zero_product();
+        multiply_add(p, _mm_xor_si128(y, load_reflected(blocks[0])),
+                     h.power(k - 1), h.power_k(k - 1));
+        for (std::size_t j = 1; j < k; ++j) {
+            multiply_add(p, load_reflected(blocks[j]), h.power(k - 1 - j),
+                         h.power_k(k - 1 - j));
+        }
+        y = reduce(p);
+
+        blocks += k;
+        n -= k;
+    }
+    return y;
+}
+
+}  // namespace crypto::ghash::pclmul
+
+#endif
@@ -1,18 +1,158 @@
+#pragma once
 
 #include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 
 namespace crypto {
 
-extern std::array<std::array<uint8_t, 16>, 16> s_box;
-uint8_t sub_byte(uint8_t input);
-extern std::array<std::array<uint8_t, 16>, 16> inv_s_box;
-uint8_t inv_sub_byte(uint8_t input);
-extern std::array<uint8_t, 256> multiply_by_2;
-extern std::array<uint8_t, 256> multiply_by_3;
-extern std::array<uint8_t, 256> multiply_by_9;
-extern std::array<uint8_t, 256> multiply_by_11;
-extern std::array<uint8_t, 256> multiply_by_13;
-extern std::array<uint8_t, 256> multiply_by_14;
-extern std::array<uint8_t, 11> round_constants;
+// All tables are generated by the constexpr functions below, so they are
+// computed (and checked, see tables.cpp) at compile time and end up in
+// read-only data.
+namespace table_gen {
+
+// multiplication in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1
+constexpr uint8_t gf_multiply(uint8_t a, uint8_t b) {
+    uint8_t product = 0;
+    while (b != 0) {
+        if (b & 1) {
+            product ^= a;
+        }
+        a = (a << 1) ^ ((a & 0x80) ? 0x1b : 0);
+        b >>= 1;
+    }
+    return product;
+}
+
+// FIPS-197 5.1.1: multiplicative inverse followed by the affine transform
+constexpr std::array<uint8_t, 256> make_s_box() {
+    // powers of the generator 3 walk through every non-zero element, which
+    // gives all inverses in one pass: 3^i * 3^(255 - i) = 1
+    std::array<uint8_t, 256> power{};
+    uint8_t x = 1;
+    for (std::size_t i = 0; i < 255; ++i) {
+        power[i] = x;
+        x = gf_multiply(x, 3);
+    }
+
+    std::array<uint8_t, 256> inverse{};
+    for (std::size_t i = 0; i < 255; ++i) {
+        inverse[power[i]] = power[(255 - i) % 255];
+    }
+
+    std::array<uint8_t, 256> table{};
+    for (std::size_t i = 0; i < 256; ++i) {
+        const uint8_t b = inverse[i];
+        table[i] = b ^ std::rotl(b, 1) ^ std::rotl(b, 2) ^ std::rotl(b, 3) ^
+                   std::rotl(b, 4) ^ 0x63;
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> make_inverse(
+    const std::array<uint8_t, 256>& table) {
+    std::array<uint8_t, 256> result{};
+    for (std::size_t i = 0; i < 256; ++i) {
+        result[table[i]] = i;
+    }
+    return result;
+}
+
+constexpr std::array<uint8_t, 256> make_multiply_by(uint8_t factor) {
+    std::array<uint8_t, 256> table{};
+    for (std::size_t i = 0; i < 256; ++i) {
+        table[i] = gf_multiply(i, factor);
+    }
+    return table;
+}
+
+// round_constants[i] = x^(i - 1), index 0 unused
+constexpr std::array<uint8_t, 11> make_round_constants() {
+    std::array<uint8_t, 11> table{};
+    uint8_t x = 1;
+    for (std::size_t i = 1; i < table.size(); ++i) {
+        table[i] = x;
+        x = gf_multiply(x, 2);
+    }
+    return table;
+}
+
+// te0[x] is the column {2s, s, s, 3s} with s = S(x)
+constexpr std::array<uint32_t, 256> make_te(
+    const std::array<uint8_t, 256>& s_box, int rotation) {
+    std::array<uint32_t, 256> table{};
+    for (std::size_t x = 0; x < 256; ++x) {
+        const uint8_t s = s_box[x];
+        const uint32_t column = (uint32_t(gf_multiply(s, 2)) << 24) |
+                                (uint32_t(s) << 16) | (uint32_t(s) << 8) |
+                                uint32_t(gf_multiply(s, 3));
+        table[x] = std::rotr(column, 8 * rotation);
+    }
+    return table;
+}
+
+// td0[x] is the column {14s, 9s, 13s, 11s} with s = InvS(x)
+constexpr std::array<uint32_t, 256> make_td(
+    const std::array<uint8_t, 256>& inv_s_box, int rotation) {
+    std::array<uint32_t, 256> table{};
+    for (std::size_t x = 0; x < 256; ++x) {
+        const uint8_t s = inv_s_box[x];
+        const uint32_t column = (uint32_t(gf_multiply(s, 14)) << 24) |
+                                (uint32_t(gf_multiply(s, 9)) << 16) |
+                                (uint32_t(gf_multiply(s, 13)) << 8) |
+                                uint32_t(gf_multiply(s, 11));
+        table[x] = std::rotr(column, 8 * rotation);
+    }
+    return table;
+}
+
+}  // namespace table_gen
+
+inline constexpr std::array<uint8_t, 256> s_box = table_gen::make_s_box();
+inline constexpr std::array<uint8_t, 256> inv_s_box =
+    table_gen::make_inverse(s_box);
+
+constexpr uint8_t sub_byte(uint8_t input) { return s_box[input]; }
+constexpr uint8_t inv_sub_byte(uint8_t input) { return inv_s_box[input]; }
+
+inline constexpr std::array<uint8_t, 256> multiply_by_2 =
+    table_gen::make_multiply_by(2);
+inline constexpr std::array<uint8_t, 256> multiply_by_3 =
+    table_gen::make_multiply_by(3);
+inline constexpr std::array<uint8_t, 256> multiply_by_9 =
+    table_gen::make_multiply_by(9);
+inline constexpr std::array<uint8_t, 256> multiply_by_11 =
+    table_gen::make_multiply_by(11);
+inline constexpr std::array<uint8_t, 256> multiply_by_13 =
+    table_gen::make_multiply_by(13);
+inline constexpr std::array<uint8_t, 256> multiply_by_14 =
+    table_gen::make_multiply_by(14);
+inline constexpr std::array<uint8_t, 11> round_constants =
+    table_gen::make_round_constants();
+
+// T-tables: SubBytes and MixColumns of a single byte, as the column word it
+// contributes to (big-endian, row 0 in the top byte). te1..te3 are te0
+// rotated by 1..3 bytes.
+alignas(64) inline constexpr std::array<uint32_t, 256> te0 =
+    table_gen::make_te(s_box, 0);
+alignas(64) inline constexpr std::array<uint32_t, 256> te1 =
+    table_gen::make_te(s_box, 1);
+alignas(64) inline constexpr std::array<uint32_t, 256> te2 =
+    table_gen::make_te(s_box, 2);
+alignas(64) inline constexpr std::array<uint32_t, 256> te3 =
+    table_gen::make_te(s_box, 3);
+
+// Inverse T-tables: InvSubBytes and InvMixColumns of a single byte, same
+// layout as te0..te3. Used with the equivalent inverse cipher schedule,
+// `RoundKeys::decryption()`.
+alignas(64) inline constexpr std::array<uint32_t, 256> td0 =
+    table_gen::make_td(inv_s_box, 0);
+alignas(64) inline constexpr std::array<uint32_t, 256> td1 =
+    table_gen::make_td(inv_s_box, 1);
+alignas(64) inline constexpr std::array<uint32_t, 256> td2 =
+    table_gen::make_td(inv_s_box, 2);
+alignas(64) inline constexpr std::array<uint32_t, 256> td3 =
+    table_gen::make_td(inv_s_box, 3);
+
 }  // namespace crypto
@@ -1,6 +1,11 @@
 #include <catch2/catch_test_macros.hpp>
 #include <crypto/aes.hpp>
+#include <crypto/aesni.hpp>
+#include <crypto/bitslice.hpp>
+#include <crypto/cpu.hpp>
 #include <crypto/crypto.hpp>
+#include <crypto/tables.hpp>
+#include <deque>
 #include <iostream>
 
 using namespace crypto;
@@ -104,7 +109,7 @@ TEST_CASE("Encrypt 128") {
         0xf1, 0xc3, 0x94, 0x58, 0xc6, 0x53, 0xea, 0x5a,
     };
 
-    AesKey key(key_bytes);
+    const AesKey key(key_bytes);
     for (size_t i = 0; i < key.get_key().size(); i++) {
         std::cout << std::setfill('0') << std::setw(2) << std::hex
                   << (int)key.get_key()[i] << " ";
@@ -135,3 +140,211 @@ TEST_CASE("Encrypt and decrypt") {
 
     REQUIRE(plaintext == result);
 }
+
+TEST_CASE("Encrypt FIPS-197 example vectors") {
+    const Block plaintext{
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+        0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+    };
+
+    std::vector<uint8_t> key_bytes{};
+    for (uint8_t i = 0; i < 32; ++i) {
+        key_bytes.push_back(i);
+    }
+
+    SECTION("128 bit key") {
+        const AesKey key({key_bytes.begin(), key_bytes.begin() + 16});
+        const Block expected{
+            0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+            0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+        };
+        REQUIRE(encrypt(plaintext, key) == expected);
+        REQUIRE(decrypt(expected, key) == plaintext);
+    }
+
+    SECTION("192 bit key") {
+        const AesKey key({key_bytes.begin(), key_bytes.begin() + 24});
+        const Block expected{
+            0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0,
+            0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91,
+        };
+        REQUIRE(encrypt(plaintext, key) == expected);
+        REQUIRE(decrypt(expected, key) == plaintext);
+    }
+
+    SECTION("256 bit key") {
+        const AesKey key(key_bytes);
+        const Block expected{
+            0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+            0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89,
+        };
+        REQUIRE(encrypt(plaintext, key) == expected);
+        REQUIRE(decrypt(expected, key) == plaintext);
+    }
+}
+
+// runs a test case on one engine, back to `Engine::Auto` when it ends
+struct UseEngine {
+        explicit UseEngine(Engine engine) { REQUIRE(set_engine(engine)); }
+        ~UseEngine() { set_engine(Engine::Auto); }
+};
+
+TEST_CASE("T-table cipher matches byte-wise cipher") {
+    const UseEngine table{Engine::Table};
+
+    std::vector<uint8_t> key_bytes{};
+    for (uint8_t i = 0; i < 32; ++i) {
+        key_bytes.push_back(0xa5 ^ (i * 7));
+    }
+
+    for (const std::size_t key_len : {16, 24, 32}) {
+        const AesKey key({key_bytes.begin(), key_bytes.begin() + key_len});
+
+        Block block{};
+        for (int i = 0; i < 64; ++i) {
+            fill_bytes_n(block, BLOCK_SIZE);
+            REQUIRE(encrypt(block, key) == encrypt_bytewise(block, key));
+            REQUIRE(decrypt(block, key) == decrypt_bytewise(block, key));
+        }
+    }
+}
+
+TEST_CASE("Bitsliced cipher matches byte-wise cipher") {
+    const UseEngine bitslice{Engine::Bitslice};
+    REQUIRE(engine() == Engine::Bitslice);
+
+    std::vector<uint8_t> key_bytes{};
+    for (uint8_t i = 0; i < 32; ++i) {
+        key_bytes.push_back(0x5a ^ (i * 13));
+    }
+
+    for (const std::size_t key_len : {16, 24, 32}) {
+        const AesKey key({key_bytes.begin(), key_bytes.begin() + key_len});
+
+        // single blocks, the narrow tail, one full pass and a ragged tail
+        for (const std::size_t n : {1, 3, 4, 5, 8, 19}) {
+            std::vector<Block> plaintext(n);
+            for (Block& block : plaintext) {
+                fill_bytes_n(block, BLOCK_SIZE);
+            }
+
+            std::vector<Block> ciphertext(n);
+            encrypt_blocks(key.round_keys(), plaintext, ciphertext);
+            for (std::size_t i = 0; i < n; ++i) {
+                REQUIRE(ciphertext[i] == encrypt_bytewise(plaintext[i], key));
+                REQUIRE(decrypt(ciphertext[i], key) ==
+                        decrypt_bytewise(ciphertext[i], key));
+            }
+
+            decrypt_blocks(key.round_keys(), ciphertext, ciphertext);
+            REQUIRE(ciphertext == plaintext);
+        }
+    }
+}
+
+TEST_CASE("Bitsliced S-box") {
+    for (uint32_t x = 0; x < 256; ++x) {
+        const uint32_t word = x | ((x ^ 0x55) << 8) | ((255 - x) << 16) |
+                              ((x * 7 & 0xff) << 24);
+        const uint32_t expected =
+            sub_byte(x) | (sub_byte(x ^ 0x55) << 8) |
+            (sub_byte(255 - x) << 16) |
+            (uint32_t(sub_byte(x * 7 & 0xff)) << 24);
+        REQUIRE(bitslice::sub_word(word) == expected);
+    }
+}
+
+TEST_CASE("AES-NI matches byte-wise encrypt") {
+    if (!cpu::has_aesni()) {
+        return;
+    }
+
+    std::vector<uint8_t> key_bytes{};
+    for (uint8_t i = 0; i < 32; ++i) {
+        key_bytes.push_back(0x3c ^ (i * 11));
+    }
+
+    for (const std::size_t key_len : {16, 24, 32}) {
+        const AesKey key({key_bytes.begin(), key_bytes.begin() + key_len});
+        const RoundKeys& round_keys = key.round_keys();
+
+        Block block{};
+        for (int i = 0; i < 64; ++i) {
+            fill_bytes_n(block, BLOCK_SIZE);
+
+            Block result{block};
+            aesni::encrypt(round_keys.encryption(), round_keys.rounds(),
+                           result);
+            REQUIRE(result == encrypt_bytewise(block, key));
+
+            aesni::decrypt(round_keys.decryption(), round_keys.rounds(),
+                           result);
+            REQUIRE(result == block);
+        }
+    }
+}
+
+TEST_CASE("Batch encrypt and decrypt") {
+    const std::vector<uint8_t> key_bytes{
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+    };
+    const AesKey key(key_bytes);
+
+    // not a multiple of the batch width, to cover the tail
+    std::vector<Block> plaintext(19);
+    for (Block& block : plaintext) {
+        fill_bytes_n(block, BLOCK_SIZE);
+    }
+
+    std::vector<Block> ciphertext(plaintext.size());
+    encrypt_blocks(key.round_keys(), plaintext, ciphertext);
+
+    for (std::size_t i = 0; i < plaintext.size(); ++i) {
+        REQUIRE(ciphertext[i] == encrypt_bytewise(plaintext[i], key));
+    }
+
+    SECTION("in place") {
+        std::vector<Block> buf{ciphertext};
+        decrypt_blocks(key.round_keys(), buf, buf);
+        REQUIRE(buf == plaintext);
+    }
+}
+
+TEST_CASE("Multi-key batch encrypt") {
+    std::vector<uint8_t> key_bytes{};
+    for (uint8_t i = 0; i < 32; ++i) {
+        key_bytes.push_back(0x6b ^ (i * 5));
+    }
+
+    // every key size, with runs of the same key and of the same rounds
+    std::deque<AesKey> keys{};
+    for (const std::size_t key_len : {16, 16, 24, 32, 16}) {
+        key_bytes[0] ^= 1;
+        keys.emplace_back(std::vector<uint8_t>{key_bytes.begin(),
+                                               key_bytes.begin() + key_len});
+    }
+
+    std::vector<const RoundKeys*> schedules(37);
+    std::vector<Block> plaintext(schedules.size());
+    for (std::size_t i = 0; i < schedules.size(); ++i) {
+        schedules[i] = &keys[(i / 3) % keys.size()].round_keys();
+        fill_bytes_n(plaintext[i], BLOCK_SIZE);
+    }
+
+    std::vector<Engine> engines{Engine::Bitslice, Engine::Table};
+    if (cpu::has_aesni()) {
+        engines.push_back(Engine::AesNi);
+    }
+    for (const Engine e : engines) {
+        const UseEngine use{e};
+
+        std::vector<Block> ciphertext(plaintext.size());
+        encrypt_blocks(schedules, plaintext, ciphertext);
+        for (std::size_t i = 0; i < plaintext.size(); ++i) {
+            REQUIRE(ciphertext[i] ==
+                    encrypt_bytewise(plaintext[i],
+                                     keys[(i / 3) % keys.size()]));
+        }
+    }
+}
@@ -1,7 +1,11 @@
-#include <boost/multiprecision/cpp_int.hpp>
+#include <bit>
 #include <catch2/catch_test_macros.hpp>
+#include <crypto/aes.hpp>
 #include <crypto/ciphermode.hpp>
 #include <cstdint>
+#include <io/io.hpp>
+#include <sstream>
+#include <string>
 
 namespace crypto::ciphermode {
 
@@ -31,11 +35,1016 @@ TEST_CASE("gcm_utils::inc_counter") {
 */
 }
 
+namespace {
+
+const std::vector<uint8_t> key_bytes{
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+// encrypt `plaintext` and decrypt it again with `Mode`
+template <class Mode>
+std::string roundtrip(const std::string& plaintext) {
+    AesKey key(key_bytes);
+    Block iv{0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8,
+             0x88};
+
+    std::istringstream in{plaintext};
+    std::ostringstream ciphertext{};
+    Mode{key, in, ciphertext, iv}.encrypt_fd();
+
+    std::istringstream cipher_in{ciphertext.str()};
+    std::ostringstream out{};
+    Mode{key, cipher_in, out, iv}.decrypt_fd();
+
+    return out.str();
+}
+
+// sizes around the block and chunk boundaries
+const std::vector<std::size_t> sizes{0,    1,    15,    16,   17,
+                                     4095, 4096, 16384, 16400, 40000};
+
+std::string make_plaintext(std::size_t n) {
+    std::string plaintext(n, '\0');
+    for (std::size_t i = 0; i < n; ++i) {
+        plaintext[i] = static_cast<char>(i * 31 + 7);
+    }
+    return plaintext;
+}
+
+}  // namespace
+
+TEST_CASE("CipherMode::encrypt_fd and CipherMode::decrypt_fd") {
+    for (const std::size_t n : sizes) {
+        const std::string plaintext = make_plaintext(n);
+
+        REQUIRE(roundtrip<ECB>(plaintext) == plaintext);
+        REQUIRE(roundtrip<CBC>(plaintext) == plaintext);
+        REQUIRE(roundtrip<GCM>(plaintext) == plaintext);
+        REQUIRE(roundtrip<CTR>(plaintext) == plaintext);
+    }
+}
+
+TEST_CASE("CBC decryption on several threads") {
+    AesKey key(key_bytes);
+    const Block iv{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                   0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+
+    // uneven ranges of about 1 MiB, and a padded final block
+    const std::string plaintext = make_plaintext(3 * 1024 * 1024 + 12345);
+
+    Block encrypt_iv{iv};
+    std::istringstream in{plaintext};
+    std::ostringstream ciphertext{};
+    CBC{key, in, ciphertext, encrypt_iv}.encrypt_fd();
+
+    for (const std::size_t threads : {1, 2, 3, 8}) {
+        Block decrypt_iv{iv};
+        std::istringstream cipher_in{ciphertext.str()};
+        std::ostringstream out{};
+        CBC{key, cipher_in, out, decrypt_iv, threads}.decrypt_fd();
+        REQUIRE(out.str() == plaintext);
+    }
+}
+
+TEST_CASE("CTR") {
+    AesKey key(key_bytes);
+
+    const auto crypt = [&](bool decrypt, Block iv, const std::string& input,
+                           std::size_t threads = 1, uint64_t first = 0) {
+        std::istringstream in{input};
+        std::ostringstream out{};
+        CTR ctr{key, in, out, iv, threads};
+        ctr.seek(first);
+        if (decrypt) {
+            ctr.decrypt_fd();
+        } else {
+            ctr.encrypt_fd();
+        }
+        return out.str();
+    };
+
+    SECTION("NIST SP 800-38A F.5.1") {
+        const Block iv{0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+                       0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+        const std::vector<uint8_t> plaintext{
+            0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e,
+            0x11, 0x73, 0x93, 0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03,
+            0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51, 0x30,
+            0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19,
+            0x1a, 0x0a, 0x52, 0xef, 0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b,
+            0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+        };
+        const std::vector<uint8_t> ciphertext{
+            0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68,
+            0x64, 0x99, 0x0d, 0xb6, 0xce, 0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70,
+            0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff, 0x5a,
+            0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02,
+            0x0d, 0xb0, 0x3e, 0xab, 0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03,
+            0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee,
+        };
+
+        const std::string p(plaintext.begin(), plaintext.end());
+        const std::string c(ciphertext.begin(), ciphertext.end());
+        REQUIRE(crypt(false, iv, p) == c);
+        REQUIRE(crypt(true, iv, c) == p);
+
+        // a partial last block, and the stream from block 2
+        REQUIRE(crypt(false, iv, p.substr(0, 21)) == c.substr(0, 21));
+        REQUIRE(crypt(true, iv, c.substr(32), 1, 2) == p.substr(32));
+    }
+
+    SECTION("no padding") {
+        const Block iv{1, 2, 3};
+        for (const std::size_t n : sizes) {
+            const std::string plaintext = make_plaintext(n);
+            const std::string ciphertext = crypt(false, iv, plaintext);
+            REQUIRE(ciphertext.size() == n);
+            REQUIRE(crypt(true, iv, ciphertext) == plaintext);
+        }
+    }
+
+    SECTION("threads and seeking") {
+        // the low 64 bits of the counter carry into the high ones
+        const Block iv{0, 0, 0, 0, 0, 0, 0, 7,
+                       0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0, 0};
+        const std::string plaintext = make_plaintext(3 * 1024 * 1024 + 999);
+        const std::string expected = crypt(false, iv, plaintext);
+
+        for (const std::size_t threads : {2, 3, 8}) {
+            REQUIRE(crypt(false, iv, plaintext, threads) == expected);
+        }
+
+        for (const uint64_t block : {1, 4000, 100000}) {
+            const std::size_t offset = block * BLOCK_SIZE;
+            REQUIRE(crypt(true, iv, expected.substr(offset), 2, block) ==
+                    plaintext.substr(offset));
+        }
+    }
+
+    SECTION("every engine") {
+        // the counter wraps around all 128 bits within the first chunk
+        Block iv{};
+        iv.fill(0xff);
+        iv[15] = 0xf5;
+
+        for (const std::size_t n : sizes) {
+            const std::string plaintext = make_plaintext(n);
+            REQUIRE(set_engine(Engine::Table));
+            const std::string expected = crypt(false, iv, plaintext);
+
+            for (const Engine engine : {Engine::Auto, Engine::Bitslice}) {
+                REQUIRE(set_engine(engine));
+                REQUIRE(crypt(false, iv, plaintext) == expected);
+            }
+            set_engine(Engine::Auto);
+        }
+    }
+}
+
+TEST_CASE("XTS") {
+    const AesKey key(std::vector<uint8_t>(16, 0x11));
+    const AesKey tweak_key(std::vector<uint8_t>(16, 0x22));
+
+    const auto crypt = [&](bool decrypt, const std::string& input,
+                           std::size_t unit_size = XTS::DEFAULT_UNIT_SIZE,
+                           std::size_t threads = 1, uint64_t first = 0) {
+        std::istringstream in{input};
+        std::ostringstream out{};
+        XTS xts{key, tweak_key, in, out, unit_size, threads};
+        xts.seek(first);
+        if (decrypt) {
+            xts.decrypt_fd();
+        } else {
+            xts.encrypt_fd();
+        }
+        return out.str();
+    };
+
+    SECTION("IEEE 1619 vector 2") {
+        const std::vector<uint8_t> ciphertext{
+            0xc4, 0x54, 0x18, 0x5e, 0x6a, 0x16, 0x93, 0x6e, 0x39, 0x33, 0x40,
+            0x38, 0xac, 0xef, 0x83, 0x8b, 0xfb, 0x18, 0x6f, 0xff, 0x74, 0x80,
+            0xad, 0xc4, 0x28, 0x93, 0x82, 0xec, 0xd6, 0xd3, 0x94, 0xf0,
+        };
+
+        const std::string p(32, 0x44);
+        const std::string c(ciphertext.begin(), ciphertext.end());
+        REQUIRE(crypt(false, p, 32, 1, 0x3333333333) == c);
+        REQUIRE(crypt(true, c, 32, 1, 0x3333333333) == p);
+    }
+
+    SECTION("ciphertext stealing") {
+        // checked against OpenSSL's XTS-AES-128
+        const AesKey key_1(std::vector<uint8_t>{
+            0xff, 0xfe, 0xfd, 0xfc, 0xfb, 0xfa, 0xf9, 0xf8,
+            0xf7, 0xf6, 0xf5, 0xf4, 0xf3, 0xf2, 0xf1, 0xf0});
+        const AesKey key_2(std::vector<uint8_t>{
+            0xbf, 0xbe, 0xbd, 0xbc, 0xbb, 0xba, 0xb9, 0xb8,
+            0xb7, 0xb6, 0xb5, 0xb4, 0xb3, 0xb2, 0xb1, 0xb0});
+        const std::vector<uint8_t> ciphertext{
+            0x9f, 0x1e, 0xcb, 0x50, 0xf8, 0xf4, 0xff, 0xad, 0x43, 0x90, 0x8c,
+            0x40, 0xb3, 0x4c, 0xae, 0xa4, 0x95, 0xc8, 0x71, 0xf6, 0x52,
+        };
+
+        std::string p(21, '\0');
+        for (std::size_t i = 0; i < p.size(); ++i) {
+            p[i] = i;
+        }
+        const std::string c(ciphertext.begin(), ciphertext.end());
+
+        std::istringstream in{p};
+        std::ostringstream out{};
+        XTS xts{key_1, key_2, in, out};
+        xts.seek(0x9a78563412);
+        xts.encrypt_fd();
+        REQUIRE(out.str() == c);
+
+        std::vector<uint8_t> unit(p.begin(), p.end());
+        xts.encrypt_unit(0x9a78563412, unit);
+        REQUIRE(std::string(unit.begin(), unit.end()) == c);
+        xts.decrypt_unit(0x9a78563412, unit);
+        REQUIRE(std::string(unit.begin(), unit.end()) == p);
+    }
+
+    SECTION("same length, and units of at least a block") {
+        for (const std::size_t n : sizes) {
+            const std::string plaintext = make_plaintext(n);
+            if (n > 0 && n < BLOCK_SIZE) {
+                REQUIRE_THROWS_AS(crypt(false, plaintext), io::IOError);
+                continue;
+            }
+
+            const std::string ciphertext = crypt(false, plaintext);
+            REQUIRE(ciphertext.size() == n);
+            REQUIRE(crypt(true, ciphertext) == plaintext);
+        }
+
+        // the last unit, not the stream, is too short
+        REQUIRE_THROWS_AS(crypt(false, make_plaintext(512 + 15)),
+                          io::IOError);
+    }
+
+    SECTION("threads, seeking and single units") {
+        const std::size_t unit_size = 4096;
+        const std::string plaintext = make_plaintext(3 * 1024 * 1024 + 999);
+        const std::string expected = crypt(false, plaintext, unit_size);
+
+        for (const std::size_t threads : {2, 3, 8}) {
+            REQUIRE(crypt(false, plaintext, unit_size, threads) == expected);
+        }
+
+        std::istringstream in{};
+        std::ostringstream out{};
+        const XTS xts{key, tweak_key, in, out, unit_size};
+        for (const uint64_t unit : {0, 5, 300, 768}) {
+            const std::size_t offset = unit * unit_size;
+            REQUIRE(crypt(true, expected.substr(offset), unit_size, 2, unit) ==
+                    plaintext.substr(offset));
+
+            // rewritten in place, the last unit is short
+            const std::string sector = plaintext.substr(offset, unit_size);
+            std::vector<uint8_t> data(sector.begin(), sector.end());
+            xts.encrypt_unit(unit, data);
+            REQUIRE(std::string(data.begin(), data.end()) ==
+                    expected.substr(offset, unit_size));
+            xts.decrypt_unit(unit, data);
+            REQUIRE(std::string(data.begin(), data.end()) == sector);
+        }
+
+        std::vector<uint8_t> data(unit_size + 1);
+        REQUIRE_THROWS_AS(xts.encrypt_unit(0, data), io::IOError);
+        REQUIRE_THROWS_AS(xts.encrypt_unit(0, {data.data(), 15}),
+                          io::IOError);
+    }
+
+    SECTION("every engine") {
+        for (const std::size_t n : sizes) {
+            if (n > 0 && n < BLOCK_SIZE) {
+                continue;
+            }
+            const std::string plaintext = make_plaintext(n);
+            REQUIRE(set_engine(Engine::Table));
+            const std::string expected = crypt(false, plaintext);
+
+            for (const Engine engine : {Engine::Auto, Engine::Bitslice}) {
+                REQUIRE(set_engine(engine));
+                REQUIRE(crypt(false, plaintext) == expected);
+                REQUIRE(crypt(true, expected) == plaintext);
+            }
+            set_engine(Engine::Auto);
+        }
+    }
+}
+
+TEST_CASE("OCB") {
+    AesKey key(std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+                                    0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+                                    0x0c, 0x0d, 0x0e, 0x0f});
+    const Block iv{0xbb, 0xaa, 0x99, 0x88, 0x77, 0x66,
+                   0x55, 0x44, 0x33, 0x22, 0x11, 0x00};
+
+    const auto crypt = [&](bool decrypt, Block nonce, const std::string& input,
+                           const std::string& aad = "",
+                           std::size_t threads = 1) {
+        std::istringstream in{input};
+        std::ostringstream out{};
+        OCB ocb{key, in, out, nonce, threads};
+        ocb.add_aad({reinterpret_cast<const uint8_t*>(aad.data()), aad.size()});
+        if (decrypt) {
+            ocb.decrypt_fd();
+        } else {
+            ocb.encrypt_fd();
+        }
+        return out.str();
+    };
+
+    SECTION("RFC 7253 appendix A") {
+        std::string eight(8, '\0');
+        for (std::size_t i = 0; i < eight.size(); ++i) {
+            eight[i] = i;
+        }
+        const auto hex = [](const std::vector<uint8_t>& bytes) {
+            return std::string(bytes.begin(), bytes.end());
+        };
+
+        Block nonce{iv};
+        REQUIRE(crypt(false, nonce, "") ==
+                hex({0x78, 0x54, 0x07, 0xbf, 0xff, 0xc8, 0xad, 0x9e, 0xdc,
+                     0xc5, 0x52, 0x0a, 0xc9, 0x11, 0x1e, 0xe6}));
+
+        nonce[11] = 0x01;
+        const std::string c1 =
+            hex({0x68, 0x20, 0xb3, 0x65, 0x7b, 0x6f, 0x61, 0x5a,
+                 0x57, 0x25, 0xbd, 0xa0, 0xd3, 0xb4, 0xeb, 0x3a,
+                 0x25, 0x7c, 0x9a, 0xf1, 0xf8, 0xf0, 0x30, 0x09});
+        REQUIRE(crypt(false, nonce, eight, eight) == c1);
+        REQUIRE(crypt(true, nonce, c1, eight) == eight);
+
+        nonce[11] = 0x02;
+        REQUIRE(crypt(false, nonce, "", eight) ==
+                hex({0x81, 0x01, 0x7f, 0x82, 0x03, 0xf0, 0x81, 0x27, 0x71,
+                     0x52, 0xfa, 0xde, 0x69, 0x4a, 0x0a, 0x00}));
+
+        nonce[11] = 0x03;
+        REQUIRE(crypt(false, nonce, eight) ==
+                hex({0x45, 0xdd, 0x69, 0xf8, 0xf5, 0xaa, 0xe7, 0x24,
+                     0x14, 0x05, 0x4c, 0xd1, 0xf3, 0x5d, 0x82, 0x76,
+                     0x0b, 0x2c, 0xd0, 0x0d, 0x2f, 0x99, 0xbf, 0xa9}));
+    }
+
+    SECTION("no padding, and tampering is detected") {
+        const std::string aad = make_plaintext(37);
+        for (const std::size_t n : sizes) {
+            const std::string plaintext = make_plaintext(n);
+            const std::string ciphertext = crypt(false, iv, plaintext, aad);
+            REQUIRE(ciphertext.size() == n + BLOCK_SIZE);
+            REQUIRE(crypt(true, iv, ciphertext, aad) == plaintext);
+
+            std::string tampered{ciphertext};
+            tampered[n / 2] ^= 1;
+            REQUIRE_THROWS_AS(crypt(true, iv, tampered, aad), io::IOError);
+            REQUIRE_THROWS_AS(crypt(true, iv, ciphertext, aad + "x"),
+                              io::IOError);
+        }
+    }
+
+    SECTION("additional data in pieces") {
+        const std::string aad = make_plaintext(1000);
+        const std::string expected = crypt(false, iv, "message", aad);
+
+        for (const std::size_t piece : {1, 15, 16, 17, 300}) {
+            Block nonce{iv};
+            std::istringstream in{"message"};
+            std::ostringstream out{};
+            OCB ocb{key, in, out, nonce};
+            for (std::size_t i = 0; i < aad.size(); i += piece) {
+                const std::string part = aad.substr(i, piece);
+                ocb.add_aad({reinterpret_cast<const uint8_t*>(part.data()),
+                             part.size()});
+            }
+            ocb.encrypt_fd();
+            REQUIRE(out.str() == expected);
+        }
+    }
+
+    SECTION("threads") {
+        const std::string plaintext = make_plaintext(3 * 1024 * 1024 + 999);
+        const std::string expected = crypt(false, iv, plaintext);
+
+        for (const std::size_t threads : {2, 3, 8}) {
+            REQUIRE(crypt(false, iv, plaintext, "", threads) == expected);
+            REQUIRE(crypt(true, iv, expected, "", threads) == plaintext);
+        }
+    }
+
+    SECTION("every engine") {
+        for (const std::size_t n : sizes) {
+            const std::string plaintext = make_plaintext(n);
+            REQUIRE(set_engine(Engine::Table));
+            const std::string expected = crypt(false, iv, plaintext);
+
+            for (const Engine engine : {Engine::Auto, Engine::Bitslice}) {
+                REQUIRE(set_engine(engine));
+                REQUIRE(crypt(false, iv, plaintext) == expected);
+                REQUIRE(crypt(true, iv, expected) == plaintext);
+            }
+            set_engine(Engine::Auto);
+        }
+    }
+}
+
+TEST_CASE("ocb_utils::LTable::offset") {
+    const AesKey key(key_bytes);
+    const ocb_utils::LTable table{key.round_keys()};
+
+    // the running XOR of L_ntz(i)
+    Block offset{};
+    for (uint64_t i = 1; i <= 5000; ++i) {
+        offset ^= table[std::countr_zero(i)];
+        REQUIRE(table.offset(i) == offset);
+    }
+    REQUIRE(table[0] == ocb_utils::twice(table.dollar()));
+}
+
+TEST_CASE("GCM detects tampering") {
+    AesKey key(key_bytes);
+    Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+    std::istringstream in{make_plaintext(100)};
+    std::ostringstream ciphertext{};
+    GCM{key, in, ciphertext, iv}.encrypt_fd();
+
+    std::string tampered = ciphertext.str();
+    tampered[5] ^= 1;
+
+    std::istringstream cipher_in{tampered};
+    std::ostringstream out{};
+    GCM cipher{key, cipher_in, out, iv};
+    REQUIRE_THROWS(cipher.decrypt_fd());
+}
+
+TEST_CASE("GCM ciphertext and tag are unchanged") {
+    AesKey key(key_bytes);
+    Block iv{0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8,
+             0x88};
+
+    std::istringstream in{make_plaintext(40)};
+    std::ostringstream ciphertext{};
+    GCM{key, in, ciphertext, iv}.encrypt_fd();
+
+    // padded ciphertext, then the tag
+    const std::vector<uint8_t> expected{
+        0x28, 0xa6, 0x2d, 0xca, 0x87, 0x44, 0xc3, 0x3e, 0xe7, 0xff, 0xf1,
+        0x10, 0x81, 0x68, 0xe9, 0x97, 0xae, 0x05, 0x9c, 0xb4, 0xcf, 0xd2,
+        0x08, 0xa8, 0xd4, 0x3a, 0x90, 0xd5, 0xb8, 0xc6, 0xe2, 0x13, 0x24,
+        0x49, 0xf2, 0x4b, 0x79, 0x09, 0x85, 0x2d, 0x90, 0x81, 0x11, 0x0d,
+        0x3d, 0xe2, 0x23, 0xea, 0x17, 0x48, 0xc6, 0x6e, 0x1c, 0xb8, 0x35,
+        0x8a, 0x25, 0x44, 0x05, 0xeb, 0x13, 0x03, 0x0a, 0x90,
+    };
+    const std::string result = ciphertext.str();
+    REQUIRE(std::vector<uint8_t>(result.begin(), result.end()) == expected);
+
+    SECTION("tag() leaves the stream alone") {
+        Block counter{0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce,
+                      0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88};
+        std::istringstream again{make_plaintext(40)};
+        std::ostringstream out{};
+        GCM gcm{key, again, out, counter};
+        gcm.encrypt_fd();
+
+        const std::vector<char> first = gcm.tag();
+        REQUIRE(gcm.tag() == first);
+        REQUIRE(std::string(first.begin(), first.end()) ==
+                result.substr(result.size() - BLOCK_SIZE));
+    }
+}
+
+TEST_CASE("GCM output is the same with every engine") {
+    AesKey key(key_bytes);
+
+    // the counter wraps around within the first chunk
+    const Block iv{0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+                   0xde, 0xca, 0xf8, 0x88, 0xff, 0xff, 0xff, 0xf5};
+
+    const auto encrypt = [&](Engine engine, const std::string& plaintext) {
+        REQUIRE(set_engine(engine));
+        Block counter{iv};
+        std::istringstream in{plaintext};
+        std::ostringstream ciphertext{};
+        GCM{key, in, ciphertext, counter}.encrypt_fd();
+        set_engine(Engine::Auto);
+        return ciphertext.str();
+    };
+
+    for (const std::size_t n : sizes) {
+        const std::string plaintext = make_plaintext(n);
+        const std::string expected = encrypt(Engine::Table, plaintext);
+
+        REQUIRE(encrypt(Engine::Auto, plaintext) == expected);
+        REQUIRE(encrypt(Engine::Bitslice, plaintext) == expected);
+    }
+}
+
+TEST_CASE("GCM output does not depend on the thread count") {
+    AesKey key(key_bytes);
+    const Block iv{0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+                   0xde, 0xca, 0xf8, 0x88, 0xff, 0xff, 0x00, 0x00};
+
+    const auto encrypt = [&](std::size_t threads,
+                             const std::string& plaintext) {
+        Block counter{iv};
+        std::istringstream in{plaintext};
+        std::ostringstream ciphertext{};
+        GCM{key, in, ciphertext, counter, threads}.encrypt_fd();
+        return ciphertext.str();
+    };
+
+    // uneven ranges of about 1 MiB, the counter wraps in the second one
+    const std::string plaintext = make_plaintext(3 * 1024 * 1024 + 12345);
+    const std::string expected = encrypt(1, plaintext);
+
+    for (const std::size_t threads : {2, 3, 8}) {
+        const std::string ciphertext = encrypt(threads, plaintext);
+        REQUIRE(ciphertext == expected);
+
+        Block counter{iv};
+        std::istringstream in{ciphertext};
+        std::ostringstream out{};
+        GCM{key, in, out, counter, threads}.decrypt_fd();
+        REQUIRE(out.str() == plaintext);
+    }
+}
+
+TEST_CASE("CipherMode::decrypt_range") {
+    AesKey key(key_bytes);
+    const Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    const std::string plaintext = make_plaintext(40000);
+
+    const auto encrypt = [&]<class Mode>(const std::string& message) {
+        Block counter{iv};
+        std::istringstream in{message};
+        std::ostringstream out{};
+        Mode{key, in, out, counter}.encrypt_fd();
+        return out.str();
+    };
+
+    const auto range = [&]<class Mode>(const std::string& ciphertext,
+                                       uint64_t offset, uint64_t length) {
+        Block counter{iv};
+        std::istringstream in{ciphertext};
+        std::ostringstream out{};
+        Mode{key, in, out, counter}.decrypt_range(offset, length);
+        return out.str();
+    };
+
+    // inside blocks, across chunks, up to and past the end
+    const std::vector<std::pair<uint64_t, uint64_t>> ranges{
+        {0, 1},         {5, 10},       {16, 16},    {17, 40},
+        {1000, 20000},  {39990, 10},   {39990, 50}, {0, 40000},
+        {0, UINT64_MAX}, {40000, 5},   {50000, 5},
+    };
+
+    for (const std::size_t n : {std::size_t(40000), std::size_t(39999)}) {
+        const std::string message = plaintext.substr(0, n);
+        const std::string ctr = encrypt.operator()<CTR>(message);
+        const std::string gcm = encrypt.operator()<GCM>(message);
+
+        for (const auto& [offset, length] : ranges) {
+            const std::string expected =
+                offset < n ? message.substr(offset, length) : "";
+            REQUIRE(range.operator()<CTR>(ctr, offset, length) == expected);
+            REQUIRE(range.operator()<GCM>(gcm, offset, length) == expected);
+        }
+    }
+
+    SECTION("the tag is not checked") {
+        std::string gcm = encrypt.operator()<GCM>(plaintext);
+        gcm.back() ^= 1;
+        REQUIRE(range.operator()<GCM>(gcm, 100, 10) ==
+                plaintext.substr(100, 10));
+    }
+
+    SECTION("needs random access and a whole ciphertext") {
+        const std::string cbc = encrypt.operator()<CBC>(plaintext);
+        REQUIRE_THROWS(range.operator()<CBC>(cbc, 0, 10));
+
+        const std::string gcm = encrypt.operator()<GCM>(plaintext);
+        REQUIRE_THROWS(range.operator()<GCM>(gcm.substr(0, 15), 0, 10));
+        REQUIRE_THROWS(
+            range.operator()<GCM>(gcm.substr(0, gcm.size() - 1), 0, 10));
+    }
+}
+
+TEST_CASE("GCM additional authenticated data") {
+    AesKey key(key_bytes);
+    const Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    const std::string plaintext = make_plaintext(1000);
+
+    std::vector<uint8_t> aad(100);
+    for (std::size_t i = 0; i < aad.size(); ++i) {
+        aad[i] = static_cast<uint8_t>(i * 13 + 1);
+    }
+
+    // `aad` in pieces of `piece` bytes
+    const auto encrypt = [&](std::size_t piece) {
+        Block counter{iv};
+        std::istringstream in{plaintext};
+        std::ostringstream ciphertext{};
+        GCM cipher{key, in, ciphertext, counter};
+        for (std::size_t i = 0; i < aad.size(); i += piece) {
+            cipher.add_aad(std::span{aad}.subspan(
+                i, std::min(piece, aad.size() - i)));
+        }
+        cipher.encrypt_fd();
+        return ciphertext.str();
+    };
+
+    const auto decrypt = [&](const std::string& ciphertext,
+                             std::span<const uint8_t> with) {
+        Block counter{iv};
+        std::istringstream in{ciphertext};
+        std::ostringstream out{};
+        GCM cipher{key, in, out, counter};
+        cipher.add_aad(with);
+        cipher.decrypt_fd();
+        return out.str();
+    };
+
+    const std::string ciphertext = encrypt(aad.size());
+
+    SECTION("only the tag changes") {
+        Block counter{iv};
+        std::istringstream in{plaintext};
+        std::ostringstream plain_ciphertext{};
+        GCM{key, in, plain_ciphertext, counter}.encrypt_fd();
+
+        const std::string other = plain_ciphertext.str();
+        REQUIRE(other.size() == ciphertext.size());
+        REQUIRE(other.substr(0, other.size() - BLOCK_SIZE) ==
+                ciphertext.substr(0, ciphertext.size() - BLOCK_SIZE));
+        REQUIRE(other != ciphertext);
+    }
+
+    SECTION("any split gives the same tag") {
+        for (const std::size_t piece : {1, 7, 16, 17, 33}) {
+            REQUIRE(encrypt(piece) == ciphertext);
+        }
+
+        std::istringstream aad_stream{std::string(aad.begin(), aad.end())};
+        Block counter{iv};
+        std::istringstream in{plaintext};
+        std::ostringstream out{};
+        GCM cipher{key, in, out, counter};
+        cipher.add_aad(aad_stream);
+        cipher.encrypt_fd();
+        REQUIRE(out.str() == ciphertext);
+    }
+
+    SECTION("decryption checks it") {
+        REQUIRE(decrypt(ciphertext, aad) == plaintext);
+
+        std::vector<uint8_t> tampered{aad};
+        tampered[42] ^= 1;
+        REQUIRE_THROWS(decrypt(ciphertext, tampered));
+        REQUIRE_THROWS(decrypt(ciphertext, {aad.data(), aad.size() - 1}));
+    }
+}
+
+TEST_CASE("GCM::verify_fd") {
+    AesKey key(key_bytes);
+    const Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+    const auto verify = [&](const std::string& ciphertext,
+                            std::size_t threads) {
+        Block counter{iv};
+        std::istringstream in{ciphertext};
+        std::ostringstream out{};
+        GCM{key, in, out, counter, threads}.verify_fd();
+        REQUIRE(out.str().empty());
+    };
+
+    for (const std::size_t n : sizes) {
+        Block counter{iv};
+        std::istringstream in{make_plaintext(n)};
+        std::ostringstream out{};
+        GCM{key, in, out, counter}.encrypt_fd();
+        const std::string ciphertext = out.str();
+
+        verify(ciphertext, 1);
+
+        std::string tampered{ciphertext};
+        tampered[n / 2] ^= 0x80;
+        REQUIRE_THROWS(verify(tampered, 1));
+        REQUIRE_THROWS(verify(ciphertext.substr(0, ciphertext.size() - 1), 1));
+    }
+
+    // partial hashes combined across threads
+    Block counter{iv};
+    std::istringstream in{make_plaintext(2 * 1024 * 1024 + 100)};
+    std::ostringstream out{};
+    GCM{key, in, out, counter}.encrypt_fd();
+    verify(out.str(), 4);
+}
+
+namespace {
+
+// `data` in bursts of `burst` bytes, like a pipe its writer fills a record
+// at a time
+class Trickle : public std::streambuf {
+    private:
+        std::string data_;
+        const std::size_t burst_;
+        std::size_t next_{0};
+
+    protected:
+        int_type underflow() override {
+            if (next_ == data_.size()) {
+                return traits_type::eof();
+            }
+            const std::size_t n = std::min(burst_, data_.size() - next_);
+            setg(data_.data() + next_, data_.data() + next_,
+                 data_.data() + next_ + n);
+            next_ += n;
+            return traits_type::to_int_type(*gptr());
+        }
+
+    public:
+        Trickle(std::string data, std::size_t burst)
+            : data_{std::move(data)}, burst_{burst} {}
+};
+
+}  // namespace
+
+TEST_CASE("GCM keystream buffer and interactive input") {
+    AesKey key(key_bytes);
+    const Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+    // `prefetch` blocks ahead, 0 without, input in bursts of `burst` bytes
+    const auto crypt = [&](bool decrypt, const std::string& input,
+                           std::size_t prefetch, std::size_t burst) {
+        Trickle trickle{input, burst};
+        std::istream in{&trickle};
+        std::ostringstream out{};
+        Block counter{iv};
+        GCM gcm{key, in, out, counter};
+        if (prefetch) {
+            gcm.prefetch(prefetch);
+            gcm.set_interactive(true);
+        }
+        if (decrypt) {
+            gcm.decrypt_fd();
+        } else {
+            gcm.encrypt_fd();
+        }
+        return out.str();
+    };
+
+    for (const std::size_t n : sizes) {
+        const std::string plaintext = make_plaintext(n);
+        const std::string expected = crypt(false, plaintext, 0, n + 1);
+
+        for (const std::size_t prefetch : {1, 3, 64}) {
+            for (const std::size_t burst : {1, 7, 200, 5000}) {
+                REQUIRE(crypt(false, plaintext, prefetch, burst) == expected);
+                REQUIRE(crypt(true, expected, prefetch, burst) == plaintext);
+            }
+        }
+    }
+
+    SECTION("one block at a time") {
+        std::istringstream in{};
+        std::ostringstream out{};
+        Block counter{iv};
+        GCM plain{key, in, out, counter};
+        counter = iv;
+        GCM ahead{key, in, out, counter};
+        ahead.prefetch(5);
+
+        for (std::size_t i = 0; i < 12; ++i) {
+            Block block{uint8_t(i)};
+            Block other{block};
+            plain.encrypt(block);
+            ahead.encrypt(other);
+            REQUIRE(block == other);
+        }
+        REQUIRE(plain.tag() == ahead.tag());
+    }
+
+    SECTION("without a tag") {
+        const std::string plaintext = make_plaintext(1000);
+        Trickle trickle{plaintext, 33};
+        std::istream in{&trickle};
+        std::ostringstream ciphertext{};
+        Block iv_cbc{iv};
+        CBC cbc{key, in, ciphertext, iv_cbc};
+        cbc.set_interactive(true);
+        cbc.encrypt_fd();
+
+        std::istringstream cipher_in{ciphertext.str()};
+        std::ostringstream out{};
+        iv_cbc = iv;
+        CBC{key, cipher_in, out, iv_cbc}.decrypt_fd();
+        REQUIRE(out.str() == plaintext);
+    }
+}
+
+TEST_CASE("GMAC") {
+    AesKey key(key_bytes);
+    const Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    const std::string message = make_plaintext(5000);
+
+    const auto mac = [&](const std::string& data) {
+        Block nonce{iv};
+        std::istringstream in{data};
+        return GMAC{key, in, nonce}.tag_fd();
+    };
+
+    const auto verify = [&](const std::string& data, const Block& tag) {
+        Block nonce{iv};
+        std::istringstream in{data};
+        GMAC{key, in, nonce}.verify_fd(tag);
+    };
+
+    const Block tag = mac(message);
+
+    SECTION("is the GCM tag of the message as additional data") {
+        std::vector<uint8_t> aad(message.begin(), message.end());
+        Block nonce{iv};
+        std::istringstream in{};
+        std::ostringstream out{};
+        GCM gcm{key, in, out, nonce};
+        gcm.add_aad(aad);
+        const std::vector<char> t = gcm.tag();
+        Block gcm_tag{};
+        std::copy(t.begin(), t.end(), gcm_tag.begin());
+        REQUIRE(gcm_tag == tag);
+    }
+
+    SECTION("verifies") {
+        REQUIRE_NOTHROW(verify(message, tag));
+
+        std::string tampered{message};
+        tampered[1234] ^= 1;
+        REQUIRE_THROWS(verify(tampered, tag));
+        REQUIRE_THROWS(verify(message + '\0', tag));
+        REQUIRE(mac("") != mac(std::string(1, '\0')));
+    }
+}
+
+TEST_CASE("GCM shards merge into the single stream") {
+    AesKey key(key_bytes);
+    const Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    const std::string plaintext = make_plaintext(70000 + 5);
+    const std::vector<uint8_t> aad{'s', 'h', 'a', 'r', 'd'};
+
+    Block counter{iv};
+    std::istringstream in{plaintext};
+    std::ostringstream out{};
+    GCM single{key, in, out, counter};
+    single.add_aad(aad);
+    single.encrypt_fd();
+    const std::string expected = out.str();
+
+    // ciphertext and `ShardState` of plaintext[begin, end)
+    const auto encrypt_shard = [&](std::size_t begin, std::size_t end,
+                                   std::size_t threads) {
+        Block shard_iv{iv};
+        std::istringstream shard_in{plaintext.substr(begin, end - begin)};
+        std::ostringstream shard_out{};
+        GCMShard{key, shard_in, shard_out, shard_iv, begin / BLOCK_SIZE,
+                 threads}
+            .encrypt_fd();
+
+        const std::string bytes = shard_out.str();
+        const std::size_t body = bytes.size() - ShardState::SIZE;
+        return std::pair{bytes.substr(0, body),
+                         ShardState::load(reinterpret_cast<const uint8_t*>(
+                             bytes.data() + body))};
+    };
+
+    const auto merge = [&](const std::vector<std::size_t>& bounds) {
+        Block merge_iv{iv};
+        std::istringstream none{};
+        std::ostringstream none_out{};
+        GCM merged{key, none, none_out, merge_iv};
+        merged.add_aad(aad);
+
+        std::string result{};
+        for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+            const auto [body, state] =
+                encrypt_shard(bounds[i], bounds[i + 1], i + 1);
+            result += body;
+            merged.append_shard(state);
+        }
+        const std::vector<char> tag = merged.tag();
+        return result + std::string(tag.begin(), tag.end());
+    };
+
+    SECTION("any aligned split") {
+        REQUIRE(merge({0, plaintext.size()}) == expected);
+        REQUIRE(merge({0, 16, plaintext.size()}) == expected);
+        REQUIRE(merge({0, 4096, 65536, 69984, plaintext.size()}) == expected);
+    }
+
+    SECTION("shards must be contiguous") {
+        Block merge_iv{iv};
+        std::istringstream none{};
+        std::ostringstream none_out{};
+        GCM merged{key, none, none_out, merge_iv};
+        merged.append_shard(encrypt_shard(0, 4096, 1).second);
+        const ShardState gap = encrypt_shard(8192, 9000, 1).second;
+        REQUIRE_THROWS(merged.append_shard(gap));
+    }
+
+    SECTION("the state round-trips") {
+        const ShardState state{{0x0102030405060708, 0x090a0b0c0d0e0f10},
+                               42,
+                               4096};
+        uint8_t bytes[ShardState::SIZE]{};
+        state.store(bytes);
+        REQUIRE(bytes[0] == 0x01);
+        REQUIRE(bytes[23] == 42);
+
+        const ShardState loaded = ShardState::load(bytes);
+        REQUIRE(loaded.hash.hi == state.hash.hi);
+        REQUIRE(loaded.hash.lo == state.hash.lo);
+        REQUIRE(loaded.first_block == 42);
+        REQUIRE(loaded.payload_len == 4096);
+    }
+}
+
 namespace gcm_utils {
 
-TEST_CASE("AuthTag::bytes_to_uint128_t and AuthTag::uint128_t_to_bytes") {
-    using boost::multiprecision::uint128_t;
+TEST_CASE("add_counter") {
+    Block counter{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0xff, 0xff, 0xfe, 0};
+    Block expected{counter};
+    for (int i = 0; i < 1000; ++i) {
+        inc_counter(expected);
+    }
+    add_counter(counter, 1000);
+    REQUIRE(counter == expected);
+}
+
+}  // namespace gcm_utils
+
+namespace ctr_utils {
+
+TEST_CASE("xts_utils::mul_alpha") {
+    Block tweak{1};
+    xts_utils::mul_alpha(tweak);
+    REQUIRE(tweak == Block{2});
+
+    // carries across bytes, and the top bit folds back in
+    tweak = Block{};
+    tweak[7] = 0x80;
+    tweak[15] = 0x80;
+    xts_utils::mul_alpha(tweak);
+    Block expected{0x87};
+    expected[8] = 1;
+    REQUIRE(tweak == expected);
+}
+
+TEST_CASE("ctr_utils::inc_counter and ctr_utils::add_counter") {
+    Block counter{};
+    counter.fill(0xff);
+    inc_counter(counter);
+    REQUIRE(counter == Block{});
+
+    counter = Block{0, 0, 0, 0, 0, 0, 0, 1, 0xff, 0xff, 0xff, 0xff,
+                    0xff, 0xff, 0xfe, 0};
+    Block expected{counter};
+    for (int i = 0; i < 1000; ++i) {
+        inc_counter(expected);
+    }
+    add_counter(counter, 1000);
+    REQUIRE(counter == expected);
+    REQUIRE(counter[7] == 2);
+}
+
+}  // namespace ctr_utils
+
+namespace gcm_utils {
 
+TEST_CASE("AuthTag tables match galois_multiply") {
+    for (const auto tables : {AuthTag::Tables::Bits4, AuthTag::Tables::Bits8}) {
+        for (int i = 0; i < 32; ++i) {
+            Block H{};
+            Block X{};
+            fill_bytes_n(H, BLOCK_SIZE);
+            fill_bytes_n(X, BLOCK_SIZE);
+
+            AuthTag tag{H, Block{}, tables};
+            tag.update_tag(X);
+
+            REQUIRE(tag.value() ==
+                    AuthTag::galois_multiply(AuthTag::bytes_to_uint128_t(X),
+                                             AuthTag::bytes_to_uint128_t(H)));
+        }
+    }
+}
+
+TEST_CASE("AuthTag::bytes_to_uint128_t and AuthTag::uint128_t_to_bytes") {
     {
         const Block bytes{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255};
         const uint128_t result = AuthTag::bytes_to_uint128_t(bytes);
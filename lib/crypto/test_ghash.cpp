@@ -0,0 +1,127 @@
+#include <catch2/catch_test_macros.hpp>
+#include <crypto/cpu.hpp>
+#include <crypto/ghash.hpp>
+#include <vector>
+
+namespace crypto::ghash {
+
+// GCM specification, test case 2: AES-128 with the zero key, one block of
+// ciphertext and no additional data
+TEST_CASE("GHASH test vector") {
+    const Element H = load({0x66, 0xe9, 0x4b, 0xd4, 0xef, 0x8a, 0x2c, 0x3b,
+                            0x88, 0x4c, 0xfa, 0x59, 0xca, 0x34, 0x2b, 0x2e});
+    const Element C = load({0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92,
+                            0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78});
+
+    // 0 bits of additional data, 128 bits of ciphertext
+    const Element lengths{0, 128};
+
+    const Block expected{0xf3, 0x8c, 0xbb, 0x1a, 0xd6, 0x92, 0x23, 0xdc,
+                         0xc3, 0x45, 0x7a, 0xe5, 0xb6, 0xb0, 0xf8, 0x85};
+
+    SECTION("4-bit tables") {
+        const Table4 table{H};
+        Block result{};
+        store(table.multiply(table.multiply(C) ^ lengths), result);
+        REQUIRE(result == expected);
+    }
+
+    SECTION("8-bit tables") {
+        const Table8 table{H};
+        Block result{};
+        store(table.multiply(table.multiply(C) ^ lengths), result);
+        REQUIRE(result == expected);
+    }
+
+    if (cpu::has_pclmul()) {
+        SECTION("PCLMULQDQ") {
+            Block blocks[2]{};
+            store(C, blocks[0]);
+            store(lengths, blocks[1]);
+
+            Element state{};
+            Clmul{H}.update(state, blocks, 2);
+            Block result{};
+            store(state, result);
+            REQUIRE(result == expected);
+        }
+    }
+}
+
+TEST_CASE("GHASH tables agree") {
+    Block h{};
+    Block x{};
+    for (int i = 0; i < 64; ++i) {
+        fill_bytes_n(h, BLOCK_SIZE);
+        fill_bytes_n(x, BLOCK_SIZE);
+
+        const Element H = load(h);
+        const Element X = load(x);
+
+        Block r4{};
+        Block r8{};
+        store(Table4{H}.multiply(X), r4);
+        store(Table8{H}.multiply(X), r8);
+        REQUIRE(r4 == r8);
+
+        // multiplication commutes
+        Block swapped{};
+        store(Table4{X}.multiply(H), swapped);
+        REQUIRE(r4 == swapped);
+    }
+}
+
+TEST_CASE("GHASH powers") {
+    Block h{};
+    fill_bytes_n(h, BLOCK_SIZE);
+    const Element H = load(h);
+    const Table4 table{H};
+
+    Element expected = ONE;
+    for (uint64_t n = 0; n < 40; ++n) {
+        Block r_power{};
+        Block r_expected{};
+        store(power(H, n), r_power);
+        store(expected, r_expected);
+        REQUIRE(r_power == r_expected);
+
+        expected = table.multiply(expected);
+    }
+}
+
+TEST_CASE("PCLMULQDQ GHASH matches the tables") {
+    if (!cpu::has_pclmul()) {
+        return;
+    }
+
+    // around the 8 blocks folded into one reduction
+    for (const std::size_t n : {1, 2, 7, 8, 9, 16, 17, 100}) {
+        Block h{};
+        fill_bytes_n(h, BLOCK_SIZE);
+        const Element H = load(h);
+
+        std::vector<Block> blocks(n);
+        for (Block& block : blocks) {
+            fill_bytes_n(block, BLOCK_SIZE);
+        }
+
+        Block s{};
+        fill_bytes_n(s, BLOCK_SIZE);
+        Element expected = load(s);
+        Element state = expected;
+
+        const Table4 table{H};
+        for (const Block& block : blocks) {
+            expected = table.multiply(expected ^ load(block));
+        }
+        Clmul{H}.update(state, blocks.data(), n);
+
+        Block r_table{};
+        Block r_clmul{};
+        store(expected, r_table);
+        store(state, r_clmul);
+        REQUIRE(r_table == r_clmul);
+    }
+}
+
+}  // namespace crypto::ghash
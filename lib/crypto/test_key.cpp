@@ -106,3 +106,30 @@ TEST_CASE("Invalid key length") {
     std::vector<uint8_t> key_bytes = {1};
     REQUIRE_THROWS(crypto::AesKey(key_bytes));
 }
+
+TEST_CASE("Round key schedules") {
+    std::vector<uint8_t> key_bytes = {1, 1, 1, 1, 1, 1, 1, 1,
+                                      1, 1, 1, 1, 1, 1, 1, 1};
+    crypto::AesKey key(key_bytes);
+    const crypto::RoundKeys& round_keys = key.round_keys();
+
+    REQUIRE(round_keys.rounds() == 10);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(round_keys.encryption()) % 64 ==
+            0);
+
+    SECTION("decryption schedule is the equivalent inverse cipher's") {
+        const uint8_t* enc = round_keys.encryption();
+        const uint8_t* dec = round_keys.decryption();
+
+        REQUIRE(reinterpret_cast<std::uintptr_t>(dec) % 64 == 0);
+        REQUIRE(std::equal(dec, dec + 16, enc + 160));
+        REQUIRE(std::equal(dec + 160, dec + 176, enc));
+
+        // InvMixColumns of round key 9
+        const std::vector<uint8_t> expected = {
+            0x5e, 0xb4, 0x61, 0xd7, 0xf5, 0x34, 0x42, 0x1a,
+            0x2a, 0x91, 0x39, 0x1c, 0x67, 0xfb, 0xc6, 0xe0,
+        };
+        REQUIRE(std::equal(expected.begin(), expected.end(), dec + 16));
+    }
+}
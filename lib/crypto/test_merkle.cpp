@@ -0,0 +1,195 @@
+#include <catch2/catch_test_macros.hpp>
+#include <crypto/aes.hpp>
+#include <crypto/merkle.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace crypto::ciphermode {
+
+namespace {
+
+const std::vector<uint8_t> key_bytes{
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+const Block iv{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+std::string make_plaintext(std::size_t n) {
+    std::string plaintext(n, '\0');
+    for (std::size_t i = 0; i < n; ++i) {
+        plaintext[i] = static_cast<char>(i * 31 + 7);
+    }
+    return plaintext;
+}
+
+std::string encrypt(const AesKey& key, const std::string& plaintext,
+                    uint64_t chunk_size, std::size_t threads = 1) {
+    std::istringstream in{plaintext};
+    std::ostringstream out{};
+    MerkleGCM{key, threads}.encrypt_fd(in, out, iv, chunk_size);
+    return out.str();
+}
+
+std::string decrypt(const AesKey& key, const std::string& container,
+                    std::size_t threads = 1) {
+    std::istringstream in{container};
+    std::ostringstream out{};
+    MerkleGCM{key, threads}.decrypt_fd(in, out);
+    return out.str();
+}
+
+std::vector<uint64_t> verify(const AesKey& key, const std::string& container,
+                             std::size_t threads = 1) {
+    std::istringstream in{container};
+    return MerkleGCM{key, threads}.verify_fd(in);
+}
+
+// header, then chunk `index` of `chunk_size` bytes and its tag
+std::size_t chunk_offset(uint64_t chunk_size, uint64_t index) {
+    return 20 + index * (chunk_size + BLOCK_SIZE);
+}
+
+}  // namespace
+
+TEST_CASE("Merkle container round trip") {
+    AesKey key(key_bytes);
+
+    // around the chunk boundaries and the odd nodes of the tree
+    for (const std::size_t n : {0, 1, 64, 65, 1000, 1024, 4096, 4100}) {
+        const std::string plaintext = make_plaintext(n);
+        const std::string container = encrypt(key, plaintext, 64);
+
+        REQUIRE(decrypt(key, container) == plaintext);
+        REQUIRE(verify(key, container).empty());
+
+        // the output does not depend on the thread count
+        REQUIRE(encrypt(key, plaintext, 64, 3) == container);
+        REQUIRE(decrypt(key, container, 4) == plaintext);
+    }
+}
+
+TEST_CASE("Merkle chunks keep trailing bytes that look like padding") {
+    AesKey key(key_bytes);
+
+    // chunk 0 ends in 0x01 and chunk 1 in sixteen 0x10, as interior chunks
+    // and as the last one
+    for (const std::size_t n : {64, 128, 200}) {
+        std::string plaintext = make_plaintext(n);
+        plaintext[63] = 0x01;
+        if (n >= 128) {
+            std::fill_n(plaintext.begin() + 112, 16, char(0x10));
+        }
+
+        const std::string container = encrypt(key, plaintext, 64);
+        REQUIRE(decrypt(key, container) == plaintext);
+        REQUIRE(decrypt(key, container, 3) == plaintext);
+        REQUIRE(verify(key, container).empty());
+    }
+}
+
+TEST_CASE("aes-cli -m merkle round trip") {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "aes-cli-test-merkle";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // two whole chunks, the first one ending in a padding-like byte
+    std::string plaintext = make_plaintext(2 * 1024);
+    plaintext[1023] = 0x01;
+    std::ofstream{dir / "plain", std::ios::binary} << plaintext;
+
+    const auto run = [&](const std::string& args) {
+        const std::string command = std::string{AES_CLI} + " " + args +
+                                    " -m merkle -k 0123456789abcdef";
+        return std::system(command.c_str());
+    };
+    const std::string path = dir.string() + "/";
+    REQUIRE(run("encrypt --chunk-size 1024 -i " + path + "plain -o " + path +
+                "container") == 0);
+    REQUIRE(run("verify -i " + path + "container") == 0);
+    REQUIRE(run("decrypt -i " + path + "container -o " + path + "out") == 0);
+
+    std::ifstream out{dir / "out", std::ios::binary};
+    const std::string decrypted{std::istreambuf_iterator<char>{out}, {}};
+    REQUIRE(decrypted == plaintext);
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Merkle chunks are GCM messages") {
+    AesKey key(key_bytes);
+    const std::string plaintext = make_plaintext(100);
+    const std::string container = encrypt(key, plaintext, 64);
+
+    // chunk 0 under the container IV itself
+    Block nonce{iv};
+    std::istringstream in{plaintext.substr(0, 64)};
+    std::ostringstream out{};
+    GCM{key, in, out, nonce}.encrypt_fd();
+    REQUIRE(container.substr(chunk_offset(64, 0), 64 + BLOCK_SIZE) ==
+            out.str());
+}
+
+TEST_CASE("Merkle verification names the bad chunks") {
+    AesKey key(key_bytes);
+    const std::string container = encrypt(key, make_plaintext(10 * 64), 64);
+
+    SECTION("tampered data") {
+        std::string tampered{container};
+        tampered[chunk_offset(64, 3) + 5] ^= 1;
+        tampered[chunk_offset(64, 8)] ^= 1;
+
+        REQUIRE(verify(key, tampered) == std::vector<uint64_t>{3, 8});
+        REQUIRE(verify(key, tampered, 4) == std::vector<uint64_t>{3, 8});
+        REQUIRE_THROWS(decrypt(key, tampered));
+
+        std::istringstream in{tampered};
+        MerkleGCM merkle{key};
+        REQUIRE(merkle.verify_chunks(in, {0, 3, 9}) ==
+                std::vector<uint64_t>{3});
+        REQUIRE(merkle.verify_chunks(in, {2, 4}).empty());
+        REQUIRE_THROWS(merkle.verify_chunks(in, {10}));
+    }
+
+    SECTION("tampered tag") {
+        std::string tampered{container};
+        tampered[chunk_offset(64, 6) - 1] ^= 1;
+        REQUIRE(verify(key, tampered) == std::vector<uint64_t>{5});
+    }
+
+    SECTION("tampered tree") {
+        // the first node above the tags, past the padding block of the
+        // last chunk
+        std::string tampered{container};
+        tampered[chunk_offset(64, 10) + BLOCK_SIZE] ^= 1;
+        REQUIRE_THROWS(verify(key, tampered));
+        REQUIRE_THROWS(decrypt(key, tampered));
+
+        std::istringstream in{tampered};
+        REQUIRE_THROWS(MerkleGCM{key}.verify_chunks(in, {0}));
+    }
+
+    SECTION("tampered root") {
+        std::string tampered{container};
+        tampered.back() ^= 1;
+        REQUIRE_THROWS(verify(key, tampered));
+    }
+
+    SECTION("truncated") {
+        REQUIRE_THROWS(verify(key, container.substr(0, container.size() - 1)));
+        REQUIRE_THROWS(verify(key, container.substr(0, 20)));
+    }
+
+    SECTION("another key") {
+        AesKey other(std::vector<uint8_t>(16, 0));
+        REQUIRE(verify(other, container).size() == 10);
+        REQUIRE_THROWS(decrypt(other, container));
+    }
+}
+
+}  // namespace crypto::ciphermode
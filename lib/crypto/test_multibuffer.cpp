@@ -0,0 +1,155 @@
+#include <catch2/catch_test_macros.hpp>
+#include <crypto/aes.hpp>
+#include <crypto/ciphermode.hpp>
+#include <crypto/multibuffer.hpp>
+#include <cstdint>
+#include <deque>
+#include <sstream>
+#include <string>
+
+namespace crypto::multibuffer {
+
+namespace {
+
+std::vector<uint8_t> make_bytes(std::size_t n, uint8_t seed) {
+    std::vector<uint8_t> bytes(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        bytes[i] = static_cast<uint8_t>(i * 31 + seed);
+    }
+    return bytes;
+}
+
+// ciphertext and tag of `GCM`, without the stream around them
+std::string reference(const AesKey& key, Block iv,
+                      const std::vector<uint8_t>& aad,
+                      const std::vector<uint8_t>& plaintext) {
+    std::istringstream in{std::string(plaintext.begin(), plaintext.end())};
+    std::ostringstream out{};
+    ciphermode::GCM gcm{key, in, out, iv};
+    gcm.add_aad(aad);
+    gcm.encrypt_fd();
+    return out.str();
+}
+
+// ciphertext of `CBC`, without the IV
+std::string cbc_reference(const AesKey& key, Block iv,
+                          const std::vector<uint8_t>& plaintext) {
+    std::istringstream in{std::string(plaintext.begin(), plaintext.end())};
+    std::ostringstream out{};
+    ciphermode::CBC{key, in, out, iv}.encrypt_fd();
+    return out.str();
+}
+
+}  // namespace
+
+TEST_CASE("Multi-buffer GCM matches GCM") {
+    // one key per size, shared by several messages
+    std::deque<AesKey> keys{};
+    for (const std::size_t key_len : {16, 24, 32}) {
+        keys.emplace_back(make_bytes(key_len, uint8_t(key_len)));
+    }
+
+    // sizes around the block and step boundaries, more than one group
+    const std::vector<std::size_t> sizes{0,   1,   15,  16,   17,  127, 128,
+                                         129, 200, 255, 1000, 2000, 3, 48,
+                                         64,  500, 999, 1500, 16,  0};
+
+    std::vector<std::vector<uint8_t>> plaintexts{};
+    std::vector<std::vector<uint8_t>> aads{};
+    std::vector<std::vector<uint8_t>> outputs{};
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        plaintexts.push_back(make_bytes(sizes[i], uint8_t(i)));
+        aads.push_back(make_bytes(i % 4 == 0 ? 0 : 5 * i, uint8_t(i + 100)));
+        outputs.emplace_back(gcm_ciphertext_size(sizes[i]));
+    }
+
+    std::vector<GcmMessage> messages{};
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        Block iv{uint8_t(i), 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, uint8_t(i * 7)};
+        messages.push_back({&keys[i % keys.size()], iv, aads[i],
+                            plaintexts[i], outputs[i].data()});
+    }
+
+    const std::vector<Block> tags = gcm_encrypt(messages);
+    REQUIRE(tags.size() == messages.size());
+
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        const std::string expected =
+            reference(*messages[i].key, messages[i].iv, aads[i],
+                      plaintexts[i]);
+        std::string got(outputs[i].begin(), outputs[i].end());
+        got.append(tags[i].begin(), tags[i].end());
+        REQUIRE(got == expected);
+    }
+
+    SECTION("decrypts") {
+        std::vector<std::vector<uint8_t>> decrypted{};
+        std::vector<GcmMessage> opened{messages};
+        for (std::size_t i = 0; i < opened.size(); ++i) {
+            decrypted.emplace_back(outputs[i].size());
+            opened[i].input = outputs[i];
+            opened[i].output = decrypted[i].data();
+        }
+
+        // a wrong tag, a flipped ciphertext bit and a ragged input
+        std::vector<Block> given{tags};
+        given[3][0] ^= 1;
+        std::vector<uint8_t> flipped{outputs[5]};
+        flipped[2] ^= 1;
+        opened[5].input = flipped;
+        opened[7].input = opened[7].input.first(opened[7].input.size() - 1);
+
+        const std::vector<std::optional<std::size_t>> lengths =
+            gcm_decrypt(opened, given);
+        for (std::size_t i = 0; i < opened.size(); ++i) {
+            if (i == 3 || i == 5 || i == 7) {
+                REQUIRE(!lengths[i]);
+                continue;
+            }
+            REQUIRE(lengths[i] == sizes[i]);
+            REQUIRE(std::equal(plaintexts[i].begin(), plaintexts[i].end(),
+                               decrypted[i].begin()));
+        }
+        REQUIRE(std::all_of(decrypted[3].begin(), decrypted[3].end(),
+                            [](uint8_t b) { return b == 0; }));
+    }
+}
+
+TEST_CASE("Multi-buffer CBC matches CBC") {
+    std::deque<AesKey> keys{};
+    for (const std::size_t key_len : {16, 24, 32}) {
+        keys.emplace_back(make_bytes(key_len, uint8_t(key_len)));
+    }
+
+    // a long message among short ones, so chains end and take the next
+    // message at different steps
+    const std::vector<std::size_t> sizes{0,  1,    15,   16,  17,  5000, 3,
+                                         48, 1000, 2000, 255, 256, 16,   0,
+                                         64, 500,  999,  33,  129, 70000};
+
+    std::vector<std::vector<uint8_t>> plaintexts{};
+    std::vector<std::vector<uint8_t>> outputs{};
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        plaintexts.push_back(make_bytes(sizes[i], uint8_t(i)));
+        outputs.emplace_back(cbc_ciphertext_size(sizes[i]));
+    }
+
+    std::vector<CbcMessage> messages{};
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        Block iv{uint8_t(i), 2, 3, 4, 5, 6, 7, 8,
+                 9, 10, 11, 12, 13, 14, 15, uint8_t(i * 7)};
+        messages.push_back({&keys[i % keys.size()], iv, plaintexts[i],
+                            outputs[i].data()});
+    }
+
+    cbc_encrypt(messages);
+
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        const std::string expected =
+            cbc_reference(*messages[i].key, messages[i].iv, plaintexts[i]);
+        REQUIRE(std::string(outputs[i].begin(), outputs[i].end()) ==
+                expected);
+    }
+}
+
+}  // namespace crypto::multibuffer
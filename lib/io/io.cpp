@@ -24,8 +24,21 @@ const char* IOError::what() const noexcept { return msg_.c_str(); }
 const int IOError::code() const noexcept { return err_; }
 
 IO::IO(std::string in_filename, std::string out_filename, Key key,
-       ModeOfOperation mode, Command cmd)
-    : key_{key}, mode_{mode}, cmd_{cmd} {
+       ModeOfOperation mode, Command cmd, Engine engine, unsigned threads,
+       std::string aad_filename, std::string tag_filename,
+       std::optional<Iv> iv, Range range, std::vector<std::string> shards,
+       MerkleOptions merkle, uint64_t prefetch, uint64_t sector_size)
+    : iv_{iv},
+      range_{range},
+      shards_{shards},
+      merkle_{merkle},
+      prefetch_{prefetch},
+      sector_size_{sector_size},
+      key_{key},
+      mode_{mode},
+      cmd_{cmd},
+      engine_{engine},
+      threads_{threads} {
     // (optional) input output files
     if (in_filename.size()) {
         if (!std::filesystem::exists(in_filename)) {
@@ -41,6 +54,161 @@ IO::IO(std::string in_filename, std::string out_filename, Key key,
         }
     }
 
+    if (cmd_ == Command::Verify) {
+        if (mode_ != ModeOfOperation::GCM && mode_ != ModeOfOperation::GMAC &&
+            mode_ != ModeOfOperation::Merkle) {
+            throw IOError{"Only GCM, GMAC and Merkle can be verified."};
+        }
+        if (out_filename.size()) {
+            throw IOError{"verify writes no output."};
+        }
+    }
+
+    if (cmd_ == Command::Merge) {
+        if (mode_ != ModeOfOperation::GCM) {
+            throw IOError{"Only GCM shards can be merged."};
+        }
+        if (shards_.empty() || !iv_) {
+            throw IOError{"merge needs --shards and the --iv they used."};
+        }
+        for (const std::string& shard : shards_) {
+            if (!std::filesystem::exists(shard)) {
+                throw IOError{std::format("Shard not found: {}.", shard)};
+            }
+        }
+    } else if (shards_.size()) {
+        throw IOError{"--shards is only for merge."};
+    }
+
+    if (iv_ && (cmd_ == Command::Decrypt || cmd_ == Command::Verify ||
+                mode_ == ModeOfOperation::CBC ||
+                mode_ == ModeOfOperation::ECB ||
+                mode_ == ModeOfOperation::CTR ||
+                mode_ == ModeOfOperation::XTS)) {
+        throw IOError{"--iv is only for GCM, OCB, GMAC and Merkle encryption "
+                      "and merge, ciphertexts carry their IV."};
+    }
+
+    // XTS takes two AES keys of the same size, one for the data and one
+    // for the sector numbers
+    if (mode_ == ModeOfOperation::XTS) {
+        if (key_.size() != 32 && key_.size() != 64) {
+            throw IOError{"XTS needs a 256 or 512-bit key, two AES keys.",
+                          errors::Error::InvalidKey};
+        }
+        const auto half = key_.begin() + key_.size() / 2;
+        if (std::equal(key_.begin(), half, half)) {
+            throw IOError{"The two halves of an XTS key must differ.",
+                          errors::Error::InvalidKey};
+        }
+    } else if (key_.size() > 32) {
+        throw IOError{"invalid length input key", errors::Error::InvalidKey};
+    }
+
+    if (sector_size_) {
+        if (mode_ != ModeOfOperation::XTS) {
+            throw IOError{"--sector-size is only for XTS."};
+        }
+        if (sector_size_ % 16 != 0 || sector_size_ > MAX_SECTOR_SIZE) {
+            throw IOError{std::format("--sector-size is a multiple of 16, "
+                                      "at most {}.",
+                                      MAX_SECTOR_SIZE)};
+        }
+    }
+
+    if (!range_.whole() && cmd_ == Command::Decrypt) {
+        if (mode_ != ModeOfOperation::GCM && mode_ != ModeOfOperation::CTR) {
+            throw IOError{"Only CTR and GCM can decrypt a range."};
+        }
+        if (in_filename.empty()) {
+            throw IOError{"A range is found by seeking, read the ciphertext "
+                          "with -i."};
+        }
+        if (aad_filename.size()) {
+            throw IOError{"Additional data only enters the tag, which a "
+                          "range does not check."};
+        }
+    } else if (!range_.whole()) {
+        if (mode_ != ModeOfOperation::GCM || cmd_ != Command::Encrypt) {
+            throw IOError{"--offset and --length are only for GCM shards "
+                          "and for decrypting a range."};
+        }
+        if (!iv_) {
+            throw IOError{"GCM shards need the same --iv."};
+        }
+        if (range_.offset % 16 != 0 || range_.length.value_or(0) % 16 != 0) {
+            throw IOError{"GCM shards start and end on 16-byte blocks."};
+        }
+        if (aad_filename.size()) {
+            throw IOError{"Additional data goes in at merge, not per shard."};
+        }
+    }
+
+    if (mode_ == ModeOfOperation::Merkle) {
+        if (cmd_ != Command::Encrypt && in_filename.empty()) {
+            throw IOError{"Merkle chunks are found by seeking, read the "
+                          "container with -i."};
+        }
+        if (merkle_.chunk_size % 16 != 0 ||
+            merkle_.chunk_size > MAX_CHUNK_SIZE) {
+            throw IOError{std::format("--chunk-size is a multiple of 16, at "
+                                      "most {}.",
+                                      MAX_CHUNK_SIZE)};
+        }
+    }
+    if (merkle_.chunk_size &&
+        (mode_ != ModeOfOperation::Merkle || cmd_ != Command::Encrypt)) {
+        throw IOError{"--chunk-size is only for Merkle encryption."};
+    }
+    if (merkle_.chunks.size() &&
+        (mode_ != ModeOfOperation::Merkle || cmd_ != Command::Verify)) {
+        throw IOError{"--chunks is only for Merkle verify."};
+    }
+
+    if (prefetch_) {
+        if (mode_ != ModeOfOperation::GCM ||
+            (cmd_ != Command::Encrypt && cmd_ != Command::Decrypt)) {
+            throw IOError{"--prefetch is only for GCM encrypt and decrypt."};
+        }
+        if (threads_ != 1) {
+            throw IOError{"--prefetch runs on one thread, drop --threads."};
+        }
+        if (cmd_ == Command::Decrypt && !range_.whole()) {
+            throw IOError{"--prefetch streams the whole input, it does not "
+                          "go with a range."};
+        }
+        if (prefetch_ > MAX_PREFETCH) {
+            throw IOError{std::format("--prefetch is at most {} KiB.",
+                                      MAX_PREFETCH)};
+        }
+    }
+
+    if (mode_ == ModeOfOperation::GMAC) {
+        if (cmd_ == Command::Decrypt) {
+            throw IOError{"GMAC does not encrypt, use 'encrypt' to make a "
+                          "tag and 'verify' to check it."};
+        }
+        if (cmd_ == Command::Verify && tag_filename.empty()) {
+            throw IOError{"GMAC verify needs the tag file, --tag."};
+        }
+    }
+    if (tag_filename.size()) {
+        if (mode_ != ModeOfOperation::GMAC || cmd_ != Command::Verify) {
+            throw IOError{"--tag is only for GMAC verify."};
+        }
+        if (!std::filesystem::exists(tag_filename)) {
+            throw IOError{
+                std::format("Tag file not found: {}.", tag_filename)};
+        }
+
+        tagfile_ = std::ifstream{tag_filename, std::ios::binary};
+
+        if (!tagfile_->is_open()) {
+            throw IOError{
+                std::format("Failed to open tag file: {}.", tag_filename)};
+        }
+    }
+
     // (optional) input output files
     if (out_filename.size()) {
         if (std::filesystem::exists(out_filename)) {
@@ -54,6 +222,23 @@ IO::IO(std::string in_filename, std::string out_filename, Key key,
                 std::format("Failed to open output file: {}.", out_filename)};
         }
     }
+
+    if (aad_filename.size()) {
+        if (mode_ != ModeOfOperation::GCM && mode_ != ModeOfOperation::OCB) {
+            throw IOError{"Additional data needs GCM or OCB mode."};
+        }
+        if (!std::filesystem::exists(aad_filename)) {
+            throw IOError{std::format("Additional data file not found: {}.",
+                                      aad_filename)};
+        }
+
+        aadfile_ = std::ifstream{aad_filename, std::ios::binary};
+
+        if (!aadfile_->is_open()) {
+            throw IOError{std::format(
+                "Failed to open additional data file: {}.", aad_filename)};
+        }
+    }
 }
 
 Key IO::key() const { return key_; }
@@ -94,6 +279,11 @@ ModeOfOperation io::mode_op_parser(const std::string& mode) {
     const bool is_gcm = mode_lower == "gcm";
     const bool is_cbc = mode_lower == "cbc";
     const bool is_ecb = mode_lower == "ecb";
+    const bool is_gmac = mode_lower == "gmac";
+    const bool is_merkle = mode_lower == "merkle";
+    const bool is_ctr = mode_lower == "ctr";
+    const bool is_xts = mode_lower == "xts";
+    const bool is_ocb = mode_lower == "ocb";
 
     if (is_gcm) {
         return ModeOfOperation::GCM;
@@ -101,12 +291,63 @@ ModeOfOperation io::mode_op_parser(const std::string& mode) {
         return ModeOfOperation::CBC;
     } else if (is_ecb) {
         return ModeOfOperation::ECB;
+    } else if (is_gmac) {
+        return ModeOfOperation::GMAC;
+    } else if (is_merkle) {
+        return ModeOfOperation::Merkle;
+    } else if (is_ctr) {
+        return ModeOfOperation::CTR;
+    } else if (is_xts) {
+        return ModeOfOperation::XTS;
+    } else if (is_ocb) {
+        return ModeOfOperation::OCB;
     } else {
         throw IOError{std::format("Invalid mode of operation: [{}]", mode),
                       errors::Error::InvalidArgument};
     }
 }
 
+io::Engine io::engine_parser(const std::string& engine) {
+    std::string engine_lower{engine};
+    const auto fn = [](unsigned char in) -> unsigned char {
+        return std::tolower(in);
+    };
+    std::transform(engine.begin(), engine.end(), engine_lower.begin(), fn);
+
+    if (engine_lower.empty() || engine_lower == "auto") {
+        return Engine::Auto;
+    } else if (engine_lower == "aesni") {
+        return Engine::AesNi;
+    } else if (engine_lower == "bitslice") {
+        return Engine::Bitslice;
+    } else if (engine_lower == "table") {
+        return Engine::Table;
+    } else {
+        throw IOError{std::format("Invalid engine: [{}]", engine),
+                      errors::Error::InvalidArgument};
+    }
+}
+
+io::Iv io::iv_parser(const std::string& iv_arg) {
+    constexpr std::size_t IV_SIZE = 12;
+
+    const bool is_hex = std::all_of(iv_arg.begin(), iv_arg.end(),
+                                    [](unsigned char c) {
+                                        return std::isxdigit(c);
+                                    });
+    if (iv_arg.size() != 2 * IV_SIZE || !is_hex) {
+        throw IOError{std::format("Invalid IV [{}], expected 24 hex digits",
+                                  iv_arg),
+                      errors::Error::InvalidArgument};
+    }
+
+    Iv iv(IV_SIZE);
+    for (std::size_t i = 0; i < IV_SIZE; ++i) {
+        iv[i] = std::stoi(iv_arg.substr(2 * i, 2), nullptr, 16);
+    }
+    return iv;
+}
+
 Key io::key_parser(const std::string& key_arg) {
     Key key{};
 
@@ -130,9 +371,10 @@ Key io::key_parser(const std::string& key_arg) {
         }
     }
 
-    // key size correct?
+    // key size correct? 64 bytes are two keys, only for XTS
     const std::size_t keylen = key.size();
-    const bool valid_keylen = keylen == 16 || keylen == 24 || keylen == 32;
+    const bool valid_keylen =
+        keylen == 16 || keylen == 24 || keylen == 32 || keylen == 64;
 
     if (!valid_keylen) {
         throw IOError{"invalid length input key", errors::Error::InvalidKey};
@@ -150,16 +392,93 @@ io::Command io::command_parser(const std::string& command) {
         return Command::Encrypt;
     } else if (cmd == "decrypt") {
         return Command::Decrypt;
+    } else if (cmd == "verify") {
+        return Command::Verify;
+    } else if (cmd == "merge") {
+        return Command::Merge;
     } else {
-        throw IOError{
-            std::format("Invalid command [{}]. Use 'encrypt' or 'decrypt'",
-                        command),
-            errors::Error::InvalidArgument};
+        throw IOError{std::format("Invalid command [{}]. Use 'encrypt', "
+                                  "'decrypt', 'verify' or 'merge'",
+                                  command),
+                      errors::Error::InvalidArgument};
     }
 }
 
 const io::Command& io::IO::cmd() const noexcept { return cmd_; }
 
+io::Engine io::IO::engine() const noexcept { return engine_; }
+
+unsigned io::IO::threads() const noexcept { return threads_; }
+
+std::istream* io::IO::aad_fd() noexcept {
+    return aadfile_ ? &aadfile_.value() : nullptr;
+}
+
+std::istream* io::IO::tag_fd() noexcept {
+    return tagfile_ ? &tagfile_.value() : nullptr;
+}
+
+const std::optional<io::Iv>& io::IO::iv() const noexcept { return iv_; }
+
+const io::Range& io::IO::range() const noexcept { return range_; }
+
+std::istream& io::IO::input_range() {
+    if (range_.whole()) {
+        return input_fd();
+    }
+
+    std::istream& in = input_fd();
+    if (inputfile_) {
+        // an empty shard past the first would get a padding block that
+        // the whole message does not have
+        in.seekg(0, std::ios::end);
+        if (range_.offset != 0 &&
+            range_.offset >= static_cast<uint64_t>(in.tellg())) {
+            throw IOError{"--offset is at or past the end of the input",
+                          errors::Error::InvalidArgument};
+        }
+        in.seekg(range_.offset);
+    } else {
+        in.ignore(range_.offset);
+    }
+    if (!in) {
+        throw IOError{"failed to skip to --offset", errors::Error::Other};
+    }
+
+    if (!range_.length) {
+        return in;
+    }
+    range_buf_.emplace(in, *range_.length);
+    return range_fd_.emplace(&range_buf_.value());
+}
+
+const std::vector<std::string>& io::IO::shards() const noexcept {
+    return shards_;
+}
+
+const io::MerkleOptions& io::IO::merkle() const noexcept { return merkle_; }
+
+uint64_t io::IO::prefetch() const noexcept { return prefetch_; }
+
+uint64_t io::IO::sector_size() const noexcept { return sector_size_; }
+
+io::RangeBuf::RangeBuf(std::istream& source, uint64_t length)
+    : source_{source}, remaining_{length}, buffer_(1 << 16) {}
+
+io::RangeBuf::int_type io::RangeBuf::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    const uint64_t n = std::min<uint64_t>(remaining_, buffer_.size());
+    source_.read(buffer_.data(), n);
+    const std::size_t got = source_.gcount();
+    remaining_ -= got;
+
+    setg(buffer_.data(), buffer_.data(), buffer_.data() + got);
+    return got ? traits_type::to_int_type(buffer_.front()) : traits_type::eof();
+}
+
 io::IO io::parse_cli(int ac, char* av[]) noexcept {
     namespace po = boost::program_options;
     using InvalidArgument =
@@ -168,7 +487,14 @@ io::IO io::parse_cli(int ac, char* av[]) noexcept {
         boost::wrapexcept<boost::program_options::required_option>;
 
     try {
-        std::string input_file, output_file, key, mode, command;
+        std::string input_file, output_file, key, mode, command, engine;
+        std::string aad_file, tag_file, iv;
+        Range range{};
+        std::vector<std::string> shards;
+        MerkleOptions merkle{};
+        unsigned threads = 1;
+        uint64_t prefetch = 0;
+        uint64_t sector_size = 0;
 
         po::options_description desc{"Usage: aes-cli <OPTIONS>"};
         auto opt = desc.add_options();
@@ -177,9 +503,48 @@ io::IO io::parse_cli(int ac, char* av[]) noexcept {
         opt("output,o", po::value<std::string>(&output_file),
             "(optional) output file");
         opt("mode,m", po::value<std::string>(&mode)->default_value("GCM"),
-            "set mode of operation, default to GCM");
+            "set mode of operation: GCM, OCB, CBC, ECB, CTR, XTS, GMAC or "
+            "Merkle, default to GCM");
         opt("key,k", po::value<std::string>(&key),
-            "(optional) key file, of length 128, 192, 256 bits");
+            "(optional) key file, of length 128, 192, 256 bits, XTS takes "
+            "two keys: 256 or 512 bits");
+        opt("engine,e", po::value<std::string>(&engine)->default_value("auto"),
+            "block cipher engine: auto, aesni, bitslice or table. auto "
+            "takes AES-NI when available, constant-time bitslice otherwise");
+        opt("threads,t", po::value<unsigned>(&threads)->default_value(1),
+            "GCM, OCB, CTR, XTS and CBC decryption worker threads, or "
+            "Merkle chunks at a time, 0 for one per core. The output does "
+            "not depend on it");
+        opt("aad,a", po::value<std::string>(&aad_file),
+            "(optional) GCM/OCB additional authenticated data file, "
+            "decryption needs the same one");
+        opt("tag,T", po::value<std::string>(&tag_file),
+            "GMAC nonce and tag for verify, as written by encrypt -m GMAC");
+        opt("iv", po::value<std::string>(&iv),
+            "(optional) GCM/OCB/GMAC IV as 24 hex digits instead of a "
+            "random one. Never encrypt two messages with the same key and "
+            "IV");
+        opt("offset", po::value<uint64_t>(&range.offset),
+            "GCM shard: encrypt the input from this byte, a multiple of 16. "
+            "CTR/GCM decrypt: only the plaintext from this byte, any one, "
+            "unauthenticated; run verify for the GCM tag");
+        opt("length", po::value<uint64_t>(),
+            "GCM shard: encrypt this many bytes, a multiple of 16. CTR/GCM "
+            "decrypt: this many plaintext bytes. Default to the end");
+        opt("shards",
+            po::value<std::vector<std::string>>(&shards)->multitoken(),
+            "merge: GCM shard files, in message order");
+        opt("chunk-size", po::value<uint64_t>(&merkle.chunk_size),
+            "Merkle: bytes per authenticated chunk, a multiple of 16 up to "
+            "64 MiB, default to 1 MiB");
+        opt("chunks",
+            po::value<std::vector<uint64_t>>(&merkle.chunks)->multitoken(),
+            "Merkle verify: only these chunks, numbered from 0");
+        opt("prefetch", po::value<uint64_t>(&prefetch),
+            "GCM: take the input as it arrives and keep this many KiB of "
+            "keystream computed ahead, for pipes where latency matters");
+        opt("sector-size", po::value<uint64_t>(&sector_size),
+            "XTS: bytes per data unit, a multiple of 16, default to 512");
         opt("help,h", "print this help message and exit");
 
         po::variables_map vm;
@@ -196,8 +561,15 @@ io::IO io::parse_cli(int ac, char* av[]) noexcept {
             command = av[1];
         };
 
+        if (vm.count("length")) {
+            range.length = vm["length"].as<uint64_t>();
+        }
+
         return IO{input_file, output_file, key_parser(key),
-                  mode_op_parser(mode), command_parser(command)};
+                  mode_op_parser(mode), command_parser(command),
+                  engine_parser(engine), threads, aad_file, tag_file,
+                  iv.size() ? std::optional{iv_parser(iv)} : std::nullopt,
+                  range, shards, merkle, prefetch, sector_size};
 
     } catch (const IOError& err) {
         Writer::write_err(err.what());
@@ -209,7 +581,8 @@ io::IO io::parse_cli(int ac, char* av[]) noexcept {
 
     } catch (const RequiredOption& err) {
         Writer::write_err(
-            "missing required command, either 'encrypt' or 'decrypt'\n");
+            "missing required command, 'encrypt', 'decrypt', 'verify' or "
+            "'merge'\n");
         std::exit(errors::Error::InvalidArgument);
 
     } catch (...) {
@@ -15,6 +15,8 @@
 #include <iostream>
 #include <optional>
 #include <ostream>
+#include <span>
+#include <streambuf>
 #include <vector>
 
 namespace io {
@@ -55,7 +57,20 @@ class Writer {
         static inline void write_block(
             std::basic_ostream<CharT, Traits>& stream,
             const std::array<uint8_t, 16>& buf, std::size_t n) {
-            if (!(stream << buf.begin())) {
+            if (!stream.write(reinterpret_cast<const CharT*>(buf.data()),
+                              n)) {
+                throw IOError{"failed to write to output",
+                              errors::Error::Other};
+            }
+        }
+
+        // writes the first `n` blocks of `blocks` to `stream`
+        template <class CharT, class Traits = std::char_traits<CharT>>
+        static inline void write_blocks(
+            std::basic_ostream<CharT, Traits>& stream,
+            std::span<const std::array<uint8_t, 16>> blocks, std::size_t n) {
+            if (!stream.write(reinterpret_cast<const CharT*>(blocks.data()),
+                              n * sizeof(std::array<uint8_t, 16>))) {
                 throw IOError{"failed to write to output",
                               errors::Error::Other};
             }
@@ -101,6 +116,16 @@ enum ModeOfOperation : char {
     GCM = 1,
     CBC,
     ECB,
+    // GCM tag over the whole input, no ciphertext
+    GMAC,
+    // GCM in chunks under a Merkle tree of their tags
+    Merkle,
+    // counter mode, no padding and no tag
+    CTR,
+    // sector-addressed, two keys, no IV and no padding
+    XTS,
+    // single-pass AEAD, nonce and tag as in GCM
+    OCB,
 };
 
 // Parsing mode of operation string
@@ -108,9 +133,61 @@ ModeOfOperation mode_op_parser(const std::string& mode);
 
 Key key_parser(const std::string& key_arg);
 
+// GCM IV, 12 bytes
+using Iv = std::vector<uint8_t>;
+
+// Parsing 24 hex digits into an `Iv`
+Iv iv_parser(const std::string& iv_arg);
+
+// byte range of the input, to its end without `length`
+struct Range {
+        uint64_t offset{0};
+        std::optional<uint64_t> length{std::nullopt};
+
+        bool whole() const noexcept { return offset == 0 && !length; }
+};
+
+// `--chunk-size` and `--chunks` of the Merkle container
+struct MerkleOptions {
+        // 0 for the default
+        uint64_t chunk_size{0};
+
+        // chunks to verify, all of them when empty
+        std::vector<uint64_t> chunks{};
+};
+
+// At most `length` bytes of `source`, from its current position
+class RangeBuf : public std::streambuf {
+    private:
+        std::istream& source_;
+        uint64_t remaining_;
+        std::vector<char> buffer_;
+
+    protected:
+        int_type underflow() override;
+
+    public:
+        RangeBuf(std::istream& source, uint64_t length);
+};
+
+// block cipher engine, see `crypto::Engine`
+enum Engine : char {
+    Auto,
+    AesNi,
+    Bitslice,
+    Table,
+};
+
+// Parsing engine string: auto, aesni, bitslice or table
+Engine engine_parser(const std::string& engine);
+
 enum Command : char {
     Encrypt,
     Decrypt,
+    // check a GCM tag, no output
+    Verify,
+    // join GCM shards and their tag
+    Merge,
 };
 
 Command command_parser(const std::string& command);
@@ -123,15 +200,55 @@ class IO {
         // if outputfile is none, write to stdout
         std::optional<std::ofstream> outputfile_{std::nullopt};
 
+        // GCM additional authenticated data, if any
+        std::optional<std::ifstream> aadfile_{std::nullopt};
+
+        // GMAC nonce and tag to verify against
+        std::optional<std::ifstream> tagfile_{std::nullopt};
+
+        const std::optional<Iv> iv_;
+        const Range range_;
+        const std::vector<std::string> shards_;
+        const MerkleOptions merkle_;
+
+        // KiB of GCM keystream computed ahead, 0 without
+        const uint64_t prefetch_;
+
+        // bytes per XTS data unit, 0 for the default
+        const uint64_t sector_size_;
+
+        // `range_` of the input, made by `input_range()`
+        std::optional<RangeBuf> range_buf_{std::nullopt};
+        std::optional<std::istream> range_fd_{std::nullopt};
+
         const Key key_{};
 
         const ModeOfOperation mode_;
 
         const Command cmd_;
 
+        const Engine engine_;
+
+        // 0 for one per core
+        const unsigned threads_;
+
     public:
+        // `--chunk-size` bound, a chunk per thread is held in memory
+        static constexpr uint64_t MAX_CHUNK_SIZE = uint64_t(64) << 20;
+
+        // `--prefetch` bound in KiB, 64 MiB of keystream
+        static constexpr uint64_t MAX_PREFETCH = 64 * 1024;
+
+        // `--sector-size` bound, the 2^20 blocks IEEE 1619 allows
+        static constexpr uint64_t MAX_SECTOR_SIZE = uint64_t(16) << 20;
+
         IO(std::string in_filename, std::string out_filename, Key key,
-           ModeOfOperation mode, Command cmd);
+           ModeOfOperation mode, Command cmd, Engine engine = Engine::Auto,
+           unsigned threads = 1, std::string aad_filename = "",
+           std::string tag_filename = "", std::optional<Iv> iv = std::nullopt,
+           Range range = {}, std::vector<std::string> shards = {},
+           MerkleOptions merkle = {}, uint64_t prefetch = 0,
+           uint64_t sector_size = 0);
 
         ~IO() = default;
 
@@ -142,6 +259,36 @@ class IO {
         std::istream& input_fd();
         std::ostream& output_fd();
         const Command& cmd() const noexcept;
+        Engine engine() const noexcept;
+        unsigned threads() const noexcept;
+
+        // null without `--aad`
+        std::istream* aad_fd() noexcept;
+
+        // null without `--tag`
+        std::istream* tag_fd() noexcept;
+
+        // `--iv`, for GCM encryption and merging
+        const std::optional<Iv>& iv() const noexcept;
+
+        // `--offset` and `--length`
+        const Range& range() const noexcept;
+
+        // `input_fd()` from `range().offset`, ending after `range().length`
+        // bytes. Skips by seeking in files and by reading stdin.
+        std::istream& input_range();
+
+        // GCM shard files to merge, in order
+        const std::vector<std::string>& shards() const noexcept;
+
+        const MerkleOptions& merkle() const noexcept;
+
+        // `--prefetch`: KiB of keystream ahead, and input taken as it
+        // arrives. 0 without.
+        uint64_t prefetch() const noexcept;
+
+        // `--sector-size`: bytes per XTS data unit, 0 for the default
+        uint64_t sector_size() const noexcept;
 
         IO() = delete;
         IO(IO&) = delete;
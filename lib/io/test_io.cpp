@@ -2,6 +2,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <io/io.hpp>
+#include <sstream>
 
 TEST_CASE("io::mode_op_parser") {
     SECTION("parses correct mode of operation") {
@@ -22,6 +23,15 @@ TEST_CASE("io::mode_op_parser") {
             {"cBc", ModeOfOperation::CBC}, {"cBC", ModeOfOperation::CBC},
             {"Cbc", ModeOfOperation::CBC}, {"CbC", ModeOfOperation::CBC},
             {"CBc", ModeOfOperation::CBC}, {"CBC", ModeOfOperation::CBC},
+
+            {"gmac", ModeOfOperation::GMAC}, {"GMAC", ModeOfOperation::GMAC},
+
+            {"ctr", ModeOfOperation::CTR}, {"Ctr", ModeOfOperation::CTR},
+            {"CTR", ModeOfOperation::CTR},
+
+            {"xts", ModeOfOperation::XTS}, {"XTS", ModeOfOperation::XTS},
+
+            {"ocb", ModeOfOperation::OCB}, {"OCB", ModeOfOperation::OCB},
         };
 
         for (const auto& [input, output] : test_cases) {
@@ -43,6 +53,35 @@ TEST_CASE("io::mode_op_parser") {
     }
 }
 
+TEST_CASE("io::engine_parser") {
+    SECTION("parses engine names") {
+        using io::Engine;
+
+        const std::pair<std::string, Engine> test_cases[]{
+            {"", Engine::Auto},           {"auto", Engine::Auto},
+            {"AESNI", Engine::AesNi},     {"aesni", Engine::AesNi},
+            {"bitslice", Engine::Bitslice}, {"Table", Engine::Table},
+        };
+
+        for (const auto& [input, output] : test_cases) {
+            REQUIRE(io::engine_parser(input) == output);
+        }
+    }
+
+    SECTION("throws on unknown engines") {
+        REQUIRE_THROWS_AS(io::engine_parser("aes-ni"), io::IOError);
+        REQUIRE_THROWS_AS(io::engine_parser("sse"), io::IOError);
+    }
+}
+
+TEST_CASE("io::command_parser") {
+    REQUIRE(io::command_parser("encrypt") == io::Command::Encrypt);
+    REQUIRE(io::command_parser("Decrypt") == io::Command::Decrypt);
+    REQUIRE(io::command_parser("verify") == io::Command::Verify);
+    REQUIRE(io::command_parser("merge") == io::Command::Merge);
+    REQUIRE_THROWS_AS(io::command_parser("check"), io::IOError);
+}
+
 TEST_CASE("io::key_parser") {
     const auto default_key = [](std::size_t len) -> std::string {
         std::string key{};
@@ -74,7 +113,7 @@ TEST_CASE("io::key_parser") {
     };
 
     SECTION("with some key") {
-        std::size_t sizes[3]{16, 24, 32};
+        std::size_t sizes[4]{16, 24, 32, 64};
         for (const std::size_t& size : sizes) {
             const std::string mockkey = default_key(size);
             REQUIRE_NOTHROW(io::key_parser(mockkey));
@@ -90,3 +129,104 @@ TEST_CASE("io::key_parser") {
         }
     };
 };
+
+TEST_CASE("io::iv_parser") {
+    const io::Iv iv = io::iv_parser("cafebabefacedbaddecaf888");
+    REQUIRE(iv.size() == 12);
+    REQUIRE(iv[0] == 0xca);
+    REQUIRE(iv[11] == 0x88);
+
+    REQUIRE_THROWS_AS(io::iv_parser("cafebabe"), io::IOError);
+    REQUIRE_THROWS_AS(io::iv_parser("cafebabefacedbaddecaf88g"), io::IOError);
+}
+
+TEST_CASE("io::RangeBuf") {
+    std::istringstream source{std::string(200000, 'x') + "tail"};
+    source.ignore(100);
+
+    io::RangeBuf buf{source, 150000};
+    std::istream range{&buf};
+    const std::string read{std::istreambuf_iterator<char>{range}, {}};
+    REQUIRE(read.size() == 150000);
+    REQUIRE(source.tellg() == 150100);
+}
+
+TEST_CASE("io::IO --chunk-size") {
+    const auto make = [](io::Command cmd, uint64_t chunk_size) {
+        io::IO io{"", "", io::Key(16, 0), io::Merkle, cmd, io::Engine::Auto,
+                  1,  "", "",             std::nullopt, {}, {},
+                  io::MerkleOptions{chunk_size}};
+        return io.merkle().chunk_size;
+    };
+
+    REQUIRE(make(io::Command::Encrypt, 0) == 0);
+    REQUIRE(make(io::Command::Encrypt, 4096) == 4096);
+    REQUIRE(make(io::Command::Encrypt, io::IO::MAX_CHUNK_SIZE) ==
+            io::IO::MAX_CHUNK_SIZE);
+
+    REQUIRE_THROWS_AS(make(io::Command::Encrypt, 100), io::IOError);
+    REQUIRE_THROWS_AS(
+        make(io::Command::Encrypt, io::IO::MAX_CHUNK_SIZE + 16), io::IOError);
+}
+
+TEST_CASE("io::IO --prefetch") {
+    const io::Key key(16, 0);
+    const auto make = [&](io::ModeOfOperation mode, io::Command cmd,
+                          unsigned threads, uint64_t prefetch) {
+        io::IO io{"",      "", key, mode, cmd, io::Engine::Auto, threads,
+                  "",      "", std::nullopt, {}, {}, {}, prefetch};
+        return io.prefetch();
+    };
+
+    REQUIRE(make(io::GCM, io::Command::Encrypt, 1, 64) == 64);
+    REQUIRE(make(io::GCM, io::Command::Decrypt, 1, 1) == 1);
+    REQUIRE(make(io::CBC, io::Command::Encrypt, 4, 0) == 0);
+
+    REQUIRE_THROWS_AS(make(io::CBC, io::Command::Encrypt, 1, 64),
+                      io::IOError);
+    REQUIRE_THROWS_AS(make(io::GCM, io::Command::Verify, 1, 64), io::IOError);
+    REQUIRE_THROWS_AS(make(io::GCM, io::Command::Encrypt, 2, 64),
+                      io::IOError);
+    REQUIRE_THROWS_AS(
+        make(io::GCM, io::Command::Encrypt, 1, io::IO::MAX_PREFETCH + 1),
+        io::IOError);
+}
+
+TEST_CASE("io::IO decrypt range") {
+    const io::Key key(16, 0);
+    const auto make = [&](io::ModeOfOperation mode, io::Command cmd) {
+        io::IO io{"",           "", key, mode, cmd, io::Engine::Auto, 1, "",
+                  "",           std::nullopt, io::Range{100, 10}};
+        return io.range().offset;
+    };
+
+    // found by seeking, so only from a file
+    REQUIRE_THROWS_AS(make(io::GCM, io::Command::Decrypt), io::IOError);
+    REQUIRE_THROWS_AS(make(io::CTR, io::Command::Decrypt), io::IOError);
+    REQUIRE_THROWS_AS(make(io::CBC, io::Command::Decrypt), io::IOError);
+    REQUIRE_THROWS_AS(make(io::GCM, io::Command::Verify), io::IOError);
+}
+
+TEST_CASE("io::IO XTS") {
+    const auto make = [](io::ModeOfOperation mode, io::Key key,
+                         uint64_t sector_size = 0) {
+        io::IO io{"", "", key, mode, io::Command::Encrypt, io::Engine::Auto,
+                  1,  "", "",  std::nullopt, {},  {},  {},  0, sector_size};
+        return io.sector_size();
+    };
+
+    io::Key key(64, 1);
+    key[40] = 2;
+    REQUIRE(make(io::XTS, key) == 0);
+    REQUIRE(make(io::XTS, key, 4096) == 4096);
+
+    // two keys of 128 or 256 bits that differ, and 64 bytes only for XTS
+    REQUIRE_THROWS_AS(make(io::XTS, io::Key(16, 1)), io::IOError);
+    REQUIRE_THROWS_AS(make(io::XTS, io::Key(32, 1)), io::IOError);
+    REQUIRE_THROWS_AS(make(io::GCM, key), io::IOError);
+
+    REQUIRE_THROWS_AS(make(io::XTS, key, 100), io::IOError);
+    REQUIRE_THROWS_AS(make(io::XTS, key, io::IO::MAX_SECTOR_SIZE + 16),
+                      io::IOError);
+    REQUIRE_THROWS_AS(make(io::CTR, io::Key(16, 1), 512), io::IOError);
+}